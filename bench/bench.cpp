@@ -0,0 +1,288 @@
+// Refresh-cost benchmark against synthetic /proc trees.
+//
+//   monitor_bench [-n processes]... [-j threads] [-r rounds] [-d dir] [-k]
+//
+// For every -n (default: 1000 and 10000) a tree is generated and measured in
+// a forked child, so caches and open descriptors never leak between sizes.
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "fd_cache.h"
+#include "instrument.h"
+#include "linux_parser.h"
+#include "pid_scanner.h"
+#include "procfs_generator.h"
+#include "snapshot.h"
+#include "system.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+struct Settings {
+  vector<int> sizes;
+  int threads{1};
+  int rounds{5};
+  string directory;
+  bool keep{false};
+};
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Best of `rounds` runs of `body`, which performs `calls` operations
+template <typename Body>
+void Measure(const char* name, int rounds, long calls, Body body) {
+  double best = 0;
+  for (int round = 0; round < rounds; ++round) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double elapsed = Seconds(start);
+    if (round == 0 || elapsed < best) best = elapsed;
+  }
+  std::printf("  %-34s %10ld calls %12.0f ns/call %10.3f ms total\n", name,
+              calls, best * 1e9 / calls, best * 1e3);
+}
+
+// Keep results alive so the calls aren't optimized away
+volatile long sink;
+
+void Run(const Settings& settings, int size) {
+  string root = settings.directory + "/" + std::to_string(size);
+  ProcfsGenerator::Options options;
+  options.processes = size;
+  auto start = std::chrono::steady_clock::now();
+  if (!ProcfsGenerator::Generate(root, options)) {
+    std::perror(root.c_str());
+    std::exit(1);
+  }
+  std::printf("%d processes (generated in %.2f s, %d threads)\n", size,
+              Seconds(start), settings.threads);
+  Instrument::Totals before = Instrument::Read();
+  start = std::chrono::steady_clock::now();
+  if (!LinuxParser::SetProcDirectory(root)) {
+    std::perror(root.c_str());
+    std::exit(1);
+  }
+  std::printf("  fd cache capacity: %zu processes\n",
+              FdCache::Instance().Capacity());
+
+  int rounds = settings.rounds;
+  vector<int> pids = LinuxParser::Pids();
+  long count = pids.size();
+
+  Measure("LinuxParser::Pids", rounds, 1,
+          [&] { sink = LinuxParser::Pids().size(); });
+  PidScanner scanner;
+  scanner.Scan();
+  Measure("PidScanner::Scan (steady state)", rounds, 1,
+          [&] { sink = scanner.Scan(); });
+  Measure("LinuxParser::CpuStates", rounds, 1,
+          [&] { sink = LinuxParser::CpuStates().size(); });
+  Measure("LinuxParser::MemoryUtilization", rounds, 1,
+          [&] { sink = LinuxParser::MemoryUtilization() * 100; });
+  Measure("LinuxParser::UpTime", rounds, 1,
+          [&] { sink = LinuxParser::UpTime(); });
+  Measure("LinuxParser::TotalProcesses", rounds, 1,
+          [&] { sink = LinuxParser::TotalProcesses(); });
+  Measure("LinuxParser::RunningProcesses", rounds, 1,
+          [&] { sink = LinuxParser::RunningProcesses(); });
+  Measure("LinuxParser::Kernel", rounds, 1,
+          [&] { sink = LinuxParser::Kernel().size(); });
+  Measure("LinuxParser::DiskStats", rounds, 1,
+          [&] { sink = LinuxParser::DiskStats().size(); });
+  const vector<string> all_interfaces;
+  Measure("LinuxParser::NetDevStats (all)", rounds, 1, [&] {
+    sink = LinuxParser::NetDevStats(all_interfaces).size();
+  });
+  const vector<string> no_veth = System::Options{}.interfaces;
+  Measure("LinuxParser::NetDevStats (!veth*)", rounds, 1,
+          [&] { sink = LinuxParser::NetDevStats(no_veth).size(); });
+
+  Measure("LinuxParser::Stat", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Stat(pid).utime;
+  });
+  Measure("LinuxParser::Status", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Status(pid).uid;
+  });
+  Measure("LinuxParser::ActiveJiffies(pid)", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::ActiveJiffies(pid);
+  });
+  Measure("LinuxParser::UpTime(pid)", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::UpTime(pid);
+  });
+  Measure("LinuxParser::Statm", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Statm(pid).resident;
+  });
+  Measure("LinuxParser::SmapsRollup", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::SmapsRollup(pid).pss_kb;
+  });
+  Measure("LinuxParser::Io", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Io(pid).read_bytes;
+  });
+  Measure("LinuxParser::Command", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Command(pid).size();
+  });
+  Measure("LinuxParser::Ram", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Ram(pid).size();
+  });
+  Measure("LinuxParser::Uid", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::Uid(pid).size();
+  });
+  Measure("LinuxParser::User", rounds, count, [&] {
+    for (int pid : pids) sink = LinuxParser::User(pid).size();
+  });
+
+  System system;
+  system.SetThreads(settings.threads);
+  System::Options view;
+  view.max_staleness = 1;
+  system.SetOptions(view);
+  system.Processes(10);  // Prime the interval history and caches
+  Measure("System::Processes (full refresh)", rounds, 1,
+          [&] { sink = system.Processes(10).size(); });
+  // Nothing in the synthetic tree changes, so this is the all-idle case
+  view = System::Options{};
+  system.SetOptions(view);
+  Measure("System::Processes (scheduled, idle)", rounds, 1,
+          [&] { sink = system.Processes(10).size(); });
+  // Building the tree once, then keeping it, where nothing moves
+  view.tree = true;
+  system.SetOptions(view);
+  Measure("System::Processes (tree, idle)", rounds, 1,
+          [&] { sink = system.Processes(10).size(); });
+  view.tree = false;
+  // Against the full refresh: a filter on comm turns processes away at their
+  // first stat read, and one on cmd reads each cmdline once, and neither
+  // reads them again
+  view.max_staleness = 1;
+  view.filter = "comm == postgres";
+  system.SetOptions(view);
+  system.Processes(10);
+  Measure("System::Processes (filter on comm)", rounds, 1,
+          [&] { sink = system.Processes(10).size(); });
+  view.filter = "cmd ~ gunicorn";
+  system.SetOptions(view);
+  system.Processes(10);
+  Measure("System::Processes (filter on cmd)", rounds, 1,
+          [&] { sink = system.Processes(10).size(); });
+  view.filter.clear();
+  view.max_staleness = System::Options{}.max_staleness;
+  system.SetOptions(view);
+  Snapshot snapshot;
+  Measure("System::Sample (one frame)", rounds, 1, [&] {
+    system.Sample(snapshot, 10);
+    sink = snapshot.processes.size();
+  });
+  view.sort = SortKey::kMemory;
+  view.detailed_memory = true;
+  system.SetOptions(view);
+  Measure("System::Sample (memory, smaps)", rounds, 1, [&] {
+    system.Sample(snapshot, 10);
+    sink = snapshot.processes.size();
+  });
+  // Sorting by I/O reads every process's io file
+  view.sort = SortKey::kIo;
+  view.detailed_memory = false;
+  system.SetOptions(view);
+  Measure("System::Sample (io)", rounds, 1, [&] {
+    system.Sample(snapshot, 10);
+    sink = snapshot.processes.size();
+  });
+
+  for (const string& line :
+       Instrument::Report(Instrument::Read(), before, Seconds(start))) {
+    std::printf("  %s\n", line.c_str());
+  }
+}
+
+void Usage(const char* program) {
+  std::fprintf(stderr,
+               "usage: %s [-n processes]... [-j threads] [-r rounds] "
+               "[-d directory] [-k]\n",
+               program);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Settings settings;
+  int option;
+  while ((option = getopt(argc, argv, "n:j:r:d:kh")) != -1) {
+    switch (option) {
+      case 'n':
+        settings.sizes.push_back(std::atoi(optarg));
+        break;
+      case 'j':
+        settings.threads = std::atoi(optarg);
+        break;
+      case 'r':
+        settings.rounds = std::atoi(optarg);
+        break;
+      case 'd':
+        settings.directory = optarg;
+        break;
+      case 'k':
+        settings.keep = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return option == 'h' ? 0 : 1;
+    }
+  }
+  if (settings.sizes.empty()) settings.sizes = {1000, 10000};
+  if (settings.threads < 1 || settings.rounds < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+  if (settings.directory.empty()) {
+    char temporary[] = "/tmp/monitor-bench-XXXXXX";
+    if (mkdtemp(temporary) == nullptr) {
+      std::perror("mkdtemp");
+      return 1;
+    }
+    settings.directory = temporary;
+  } else if (mkdir(settings.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::perror(settings.directory.c_str());
+    return 1;
+  }
+
+  // Let the fd cache size itself to the hard limit, as a tuned host would
+  struct rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  for (int size : settings.sizes) {
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+      Run(settings, size);
+      std::fflush(stdout);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+  }
+
+  if (!settings.keep) {
+    string command = "rm -rf '" + settings.directory + "'";
+    if (std::system(command.c_str()) != 0) return 1;
+  } else {
+    std::printf("trees kept in %s\n", settings.directory.c_str());
+  }
+  return 0;
+}
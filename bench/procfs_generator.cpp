@@ -0,0 +1,246 @@
+#include "procfs_generator.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <random>
+#include <string>
+
+using std::string;
+
+namespace {
+struct Kind {
+  const char* comm;
+  const char* cmdline;  // Arguments separated by '|'; empty for kthreads
+  int uid;
+  long vm_size_kb;
+};
+
+// A mix of what a busy server runs
+const Kind kKinds[] = {
+    {"kworker/3:1-events", "", 0, 0},
+    {"ksoftirqd/7", "", 0, 0},
+    {"systemd", "/sbin/init|splash", 0, 168000},
+    {"sshd", "sshd: deploy [priv]", 0, 17000},
+    {"postgres", "postgres: checkpointer", 999, 4300000},
+    {"java", "/usr/bin/java|-Xmx31g|-XX:+UseG1GC|-cp|/opt/app/lib/*|"
+             "com.example.service.Main|--config=/etc/app/service.yaml",
+     1000, 38000000},
+    {"python3", "/usr/bin/python3|-m|gunicorn|app:server|--workers=8",
+     1000, 250000},
+    {"Web Content", "/usr/lib/firefox/firefox|-contentproc|-childID|"
+                    "12|-isForBrowser",
+     1000, 2600000},
+    {"(sd-pam)", "(sd-pam)", 1000, 170000},
+    {"nginx", "nginx: worker process", 33, 56000},
+};
+
+bool WriteFile(const string& path, const string& contents) {
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) return false;
+  bool ok = std::fwrite(contents.data(), 1, contents.size(), file) ==
+            contents.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+string Format(const char* format, ...) __attribute__((format(printf, 1, 2)));
+string Format(const char* format, ...) {
+  char buffer[4096];
+  va_list arguments;
+  va_start(arguments, format);
+  int length = std::vsnprintf(buffer, sizeof(buffer), format, arguments);
+  va_end(arguments);
+  return string(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+bool WriteSystemFiles(const string& root, const ProcfsGenerator::Options& options,
+                      std::mt19937& random) {
+  string stat;
+  std::uniform_int_distribution<long> jiffies(1000, 900000);
+  for (int cpu = -1; cpu < options.cores; ++cpu) {
+    long scale = cpu < 0 ? options.cores : 1;
+    string name = cpu < 0 ? "cpu " : Format("cpu%d", cpu);
+    stat += Format("%s %ld %ld %ld %ld %ld %ld %ld %ld 0 0\n", name.c_str(),
+                   jiffies(random) * scale, jiffies(random) / 10 * scale,
+                   jiffies(random) * scale, jiffies(random) * 10 * scale,
+                   jiffies(random) / 100 * scale, 0L,
+                   jiffies(random) / 50 * scale, jiffies(random) / 200 * scale);
+  }
+  // The real intr line lists every interrupt; it is what makes stat big
+  stat += "intr 129382";
+  for (int i = 0; i < 512; ++i) stat += Format(" %d", i % 7 == 0 ? i * 31 : 0);
+  stat += Format(
+      "\nctxt 882341\nbtime 1700000000\nprocesses %d\nprocs_running %d\n"
+      "procs_blocked 0\nsoftirq 1 2 3 4 5 6 7 8 9 10 11\n",
+      options.processes * 3, 1 + options.processes / 500);
+
+  // Two NVMe drives with partitions, a SATA disk and loop devices, which
+  // the parser has to skip
+  string diskstats;
+  std::uniform_int_distribution<unsigned long> requests(1000, 90000000);
+  const char* const kDisks[] = {"loop0",     "loop1",     "nvme0n1",
+                                "nvme0n1p1", "nvme0n1p2", "nvme1n1",
+                                "nvme1n1p1", "sda",       "sda1",
+                                "dm-0"};
+  for (int i = 0; i < 10; ++i) {
+    unsigned long reads = requests(random), writes = requests(random);
+    diskstats += Format(
+        "%4d %7d %s %lu %lu %lu %lu %lu %lu %lu %lu 0 %lu %lu 0 0 0 0 %lu "
+        "%lu\n",
+        i < 2 ? 7 : 259, i, kDisks[i], reads, reads / 20, reads * 16,
+        reads / 4, writes, writes / 3, writes * 24, writes / 2,
+        (reads + writes) / 5, (reads + writes) / 2, reads / 100, reads / 90);
+  }
+
+  // A container host: a few real interfaces and a veth per ten processes,
+  // which the default interface filter drops
+  string net_dev =
+      "Inter-|   Receive                                                |  "
+      "Transmit\n"
+      " face |bytes    packets errs drop fifo frame compressed multicast|"
+      "bytes    packets errs drop fifo colls carrier compressed\n";
+  std::uniform_int_distribution<unsigned long> bytes(1000, 900000000000);
+  int veths = options.processes / 10;
+  for (int i = -4; i < veths; ++i) {
+    const char* const kInterfaces[] = {"lo", "eth0", "eth1", "docker0"};
+    string name = i < 0 ? kInterfaces[i + 4] : Format("veth%07x", i * 2654435761u);
+    unsigned long rx = bytes(random), tx = bytes(random);
+    net_dev += Format(
+        "%*s: %lu %lu %lu %lu 0 0 0 %lu %lu %lu %lu %lu 0 0 0 0\n", 6,
+        name.c_str(), rx, rx / 900, rx / 90000000, rx / 9000000, rx / 2000000,
+        tx, tx / 1100, tx / 90000000, tx / 9000000);
+  }
+
+  mkdir((root + "/net").c_str(), 0755);
+  return WriteFile(root + "/stat", stat) &&
+         WriteFile(root + "/diskstats", diskstats) &&
+         WriteFile(root + "/net/dev", net_dev) &&
+         WriteFile(root + "/meminfo",
+                   "MemTotal:       263856892 kB\n"
+                   "MemFree:        102733112 kB\n"
+                   "MemAvailable:   198123456 kB\n"
+                   "Buffers:          1203456 kB\n"
+                   "Cached:          90123456 kB\n"
+                   "SwapCached:             0 kB\n"
+                   "SwapTotal:        8388604 kB\n"
+                   "SwapFree:         8388604 kB\n") &&
+         WriteFile(root + "/uptime", "864000.42 6543210.99\n") &&
+         WriteFile(root + "/version",
+                   "Linux version 6.1.0-bench (gcc 12.2.0) #1 SMP "
+                   "PREEMPT_DYNAMIC\n");
+}
+
+bool WriteProcess(const string& root, int pid, const Kind& kind,
+                  std::mt19937& random) {
+  string directory = root + "/" + std::to_string(pid);
+  if (mkdir(directory.c_str(), 0755) != 0) return false;
+
+  std::uniform_int_distribution<unsigned long> ticks(0, 5000000);
+  unsigned long utime = kind.vm_size_kb ? ticks(random) : ticks(random) / 100;
+  unsigned long stime = utime / 3;
+  unsigned long long starttime = 100 + pid * 7ull;
+  long rss_pages = kind.vm_size_kb / 16;
+  int ppid = pid == 1 ? 0 : (kind.vm_size_kb ? 1 : 2);
+  string stat = Format(
+      "%d (%s) S %d %d %d 0 -1 4194560 %lu 0 12 0 %lu %lu 0 0 20 0 %d 0 %llu "
+      "%lu %ld 18446744073709551615 94000000000000 94000000100000 "
+      "140730000000000 0 0 0 0 4096 17475 0 0 0 17 %d 0 0 0 0 0 "
+      "94000000200000 94000000300000 94000001000000 140730000001000 "
+      "140730000001100 140730000001100 140730000002000 0\n",
+      pid, kind.comm, ppid, pid, pid, ticks(random) / 10, utime, stime,
+      kind.vm_size_kb ? 1 + pid % 64 : 1, starttime, kind.vm_size_kb * 1024,
+      rss_pages, pid % 8);
+
+  string status = Format(
+      "Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%d\nNgid:\t0\n"
+      "Pid:\t%d\nPPid:\t%d\nTracerPid:\t0\nUid:\t%d\t%d\t%d\t%d\n"
+      "Gid:\t%d\t%d\t%d\t%d\nFDSize:\t256\nGroups:\t%d\nNStgid:\t%d\n"
+      "NSpid:\t%d\nNSpgid:\t%d\nNSsid:\t%d\n",
+      kind.comm, pid, pid, ppid, kind.uid, kind.uid, kind.uid, kind.uid,
+      kind.uid, kind.uid, kind.uid, kind.uid, kind.uid, pid, pid, pid, pid);
+  if (kind.vm_size_kb) {
+    status += Format(
+        "VmPeak:\t%ld kB\nVmSize:\t%ld kB\nVmLck:\t0 kB\nVmPin:\t0 kB\n"
+        "VmHWM:\t%ld kB\nVmRSS:\t%ld kB\nRssAnon:\t%ld kB\nRssFile:\t%ld kB\n"
+        "RssShmem:\t0 kB\nVmData:\t%ld kB\nVmStk:\t132 kB\nVmExe:\t800 kB\n"
+        "VmLib:\t9000 kB\nVmPTE:\t400 kB\nVmSwap:\t0 kB\n",
+        kind.vm_size_kb, kind.vm_size_kb, rss_pages * 4, rss_pages * 4,
+        rss_pages * 3, rss_pages, kind.vm_size_kb / 2);
+  }
+  status += Format(
+      "Threads:\t%d\nSigQ:\t0/1030000\nSigPnd:\t0000000000000000\n"
+      "ShdPnd:\t0000000000000000\nSigBlk:\t0000000000000000\n"
+      "SigIgn:\t0000000000001000\nSigCgt:\t0000000180004a02\n"
+      "CapInh:\t0000000000000000\nCapPrm:\t0000000000000000\n"
+      "CapEff:\t0000000000000000\nCapBnd:\t000001ffffffffff\n"
+      "CapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\n"
+      "Speculation_Store_Bypass:\tthread vulnerable\n"
+      "Cpus_allowed:\tffffffff\nCpus_allowed_list:\t0-31\n"
+      "Mems_allowed:\t00000001\nMems_allowed_list:\t0\n"
+      "voluntary_ctxt_switches:\t%lu\nnonvoluntary_ctxt_switches:\t%lu\n",
+      kind.vm_size_kb ? 1 + pid % 64 : 1, ticks(random), ticks(random) / 10);
+
+  // size resident shared text lib data dt, in pages; zero for kthreads
+  long size_pages = kind.vm_size_kb / 4;
+  string statm = Format("%ld %ld %ld 200 0 %ld 0\n", size_pages, rss_pages,
+                        rss_pages / 4, size_pages / 2);
+
+  // Kernel threads have no mm, so their smaps_rollup is empty
+  string smaps_rollup;
+  if (kind.vm_size_kb) {
+    long rss_kb = rss_pages * 4;
+    smaps_rollup = Format(
+        "55d6c8a4c000-7ffd2b5f9000 ---p 00000000 00:00 0                  "
+        "        [rollup]\n"
+        "Rss:            %8ld kB\nPss:            %8ld kB\n"
+        "Pss_Anon:       %8ld kB\nPss_File:       %8ld kB\n"
+        "Pss_Shmem:             0 kB\nShared_Clean:   %8ld kB\n"
+        "Shared_Dirty:          0 kB\nPrivate_Clean:  %8ld kB\n"
+        "Private_Dirty:  %8ld kB\nReferenced:     %8ld kB\n"
+        "Anonymous:      %8ld kB\nLazyFree:              0 kB\n"
+        "AnonHugePages:         0 kB\nShmemPmdMapped:        0 kB\n"
+        "FilePmdMapped:         0 kB\nShared_Hugetlb:        0 kB\n"
+        "Private_Hugetlb:       0 kB\nSwap:           %8ld kB\n"
+        "SwapPss:        %8ld kB\nLocked:                0 kB\n",
+        rss_kb, rss_kb * 3 / 4, rss_kb / 2, rss_kb / 4, rss_kb / 2,
+        rss_kb / 8, rss_kb * 3 / 8, rss_kb, rss_kb / 2, rss_kb / 10,
+        rss_kb / 10);
+  }
+
+  // Cumulative since the process started; kernel threads do no file I/O
+  unsigned long long read_bytes = kind.vm_size_kb ? ticks(random) * 4096 : 0;
+  unsigned long long write_bytes = read_bytes / 3;
+  string io = Format(
+      "rchar: %llu\nwchar: %llu\nsyscr: %llu\nsyscw: %llu\n"
+      "read_bytes: %llu\nwrite_bytes: %llu\ncancelled_write_bytes: %llu\n",
+      read_bytes * 2, write_bytes * 2, read_bytes / 8192, write_bytes / 8192,
+      read_bytes, write_bytes, write_bytes / 50);
+
+  // cmdline arguments are NUL-terminated, including the last one
+  string cmdline = kind.cmdline;
+  if (!cmdline.empty()) cmdline.push_back('|');
+  std::replace(cmdline.begin(), cmdline.end(), '|', '\0');
+
+  return WriteFile(directory + "/stat", stat) &&
+         WriteFile(directory + "/status", status) &&
+         WriteFile(directory + "/statm", statm) &&
+         WriteFile(directory + "/smaps_rollup", smaps_rollup) &&
+         WriteFile(directory + "/io", io) &&
+         WriteFile(directory + "/cmdline", cmdline);
+}
+}  // namespace
+
+bool ProcfsGenerator::Generate(const string& root, const Options& options) {
+  mkdir(root.c_str(), 0755);
+  std::mt19937 random(options.seed);
+  if (!WriteSystemFiles(root, options, random)) return false;
+
+  // Weighted towards workers and kernel threads, as on real hosts
+  std::discrete_distribution<int> kinds({20, 5, 1, 3, 8, 10, 15, 5, 2, 12});
+  for (int pid = 1; pid <= options.processes; ++pid) {
+    const Kind& kind = pid == 1 ? kKinds[2] : kKinds[kinds(random)];
+    if (!WriteProcess(root, pid, kind, random)) return false;
+  }
+  return true;
+}
@@ -0,0 +1,24 @@
+#ifndef PROCFS_GENERATOR_H
+#define PROCFS_GENERATOR_H
+
+#include <string>
+
+/*
+Writes a synthetic /proc tree for benchmarks: the system-wide files the
+monitor reads plus `processes` pid directories with stat, status, statm,
+smaps_rollup, io and cmdline contents shaped like a real host's (kernel
+threads, daemons, command names with spaces and parentheses, long JVM-style
+command lines). Output is deterministic for a given seed.
+*/
+namespace ProcfsGenerator {
+struct Options {
+  int processes{1000};
+  int cores{8};
+  unsigned seed{1};
+};
+
+// Returns false if any file can't be written
+bool Generate(const std::string& root, const Options& options);
+}  // namespace ProcfsGenerator
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "snapshot.h"
+#include "system.h"
+#include "wire.h"
+
+/*
+Headless mode for fleets: samples the system at a fixed period and serves
+the snapshots to any number of subscribers over a Unix or TCP socket (see
+Wire for the stream). Each sample is encoded once, as a delta from the one
+before, and the same frame goes to every subscriber, so the cost per tick
+doesn't grow with their number. A subscriber that joins gets a keyframe at
+once; one whose socket is still full from the last frame misses the next
+deltas and is sent a keyframe when it has caught up, so a slow reader
+never makes the agent buffer without bound. Between samples further apart
+than Wire::kKeepalivePeriod, subscribers get keepalives. A connection that
+hasn't sent its Hello within kHelloTimeout is closed.
+
+There is no authentication: listen on a Unix socket or localhost, and
+reach remote agents through SSH forwarding or the like.
+*/
+class Agent {
+ public:
+  static constexpr std::chrono::seconds kHelloTimeout{5};
+
+  Agent(System& system, std::size_t rows, std::chrono::milliseconds interval);
+  ~Agent();
+  Agent(const Agent&) = delete;
+  Agent& operator=(const Agent&) = delete;
+
+  // Returns false with errno set if the endpoint can't be listened on
+  bool Listen(const Wire::Endpoint& endpoint);
+  // Sample and serve `count` samples, 0 for no limit, each given one
+  // interval to go out; or until SIGINT or SIGTERM, which the caller must
+  // have blocked in every thread so they are taken here
+  void Run(long count);
+
+ private:
+  struct Subscriber {
+    int fd{-1};
+    bool subscribed{false};  // Once a valid Hello has arrived
+    bool behind{false};  // Missed a frame; owed a keyframe
+    std::chrono::steady_clock::time_point accepted;
+    std::string hello;
+    std::string pending;  // The rest of a frame the socket didn't take
+  };
+
+  void Accept();
+  // False once the subscriber has gone or broken the protocol
+  bool Receive(Subscriber& subscriber);
+  bool Send(Subscriber& subscriber, const std::string& frame);
+  bool Flush(Subscriber& subscriber);
+  void Publish();
+  void Keepalive();
+  void Prune();
+
+  System& system_;
+  std::size_t rows_;
+  std::chrono::milliseconds interval_;
+  int listener_{-1};
+  std::string path_;  // Of a Unix socket, removed on exit
+  Wire::Encoder encoder_;
+  bool encoded_{false};
+  Snapshot snapshot_;
+  std::string delta_;
+  std::string keyframe_;
+  std::string keepalive_;
+  std::vector<Subscriber> subscribers_;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "snapshot.h"
+#include "wire.h"
+
+/*
+The other end of Agent: subscribes to many agents at once and merges what
+they report into one snapshot of the fleet. Connections are non-blocking
+and served from one poll() loop; one that fails, hangs up, sends a corrupt
+frame or goes quiet for kSilence is dropped and retried, backing off from
+one second up to kMaxBackoff. Agents send keepalives well within kSilence,
+however long their interval.
+
+The merged snapshot lists the top processes across the fleet, each marked
+with its host. An agent only sends its own top rows, in the order of its
+own --sort, so a fleet ranked by another key covers those rows only.
+*/
+class Aggregator {
+ public:
+  // An agent goes unheard for this long before it is taken for dead
+  static constexpr std::chrono::seconds kSilence{10};
+  static constexpr std::chrono::seconds kMaxBackoff{30};
+
+  // Add an agent as "[NAME=]ENDPOINT" (see Wire::Endpoint). Without a name
+  // the agent is shown by the host name it reports.
+  bool Add(const std::string& target);
+  // Connect, and read and decode what has arrived, waiting up to
+  // `timeout_ms` for something to. True if any host's snapshot changed.
+  bool Poll(int timeout_ms);
+  // The fleet as one frame. Figures over the system are means over the
+  // hosts (CPU weighted by core count) or sums of counts; cores holds one
+  // figure per host, and disks and interfaces are named "host:device".
+  void Merge(Snapshot& snapshot, std::size_t rows, SortKey sort) const;
+
+  std::size_t Agents() const { return sources_.size(); }
+  std::size_t Connected() const;
+  // Bytes read from every agent so far
+  std::uint64_t Received() const { return received_; }
+
+ private:
+  struct Source {
+    std::string name;
+    Wire::Endpoint endpoint;
+    int fd{-1};
+    bool connecting{false};
+    std::size_t address{0};  // The next of the endpoint's to try, see Connect
+
+    std::string input;
+    Wire::Decoder decoder;
+    Snapshot snapshot;  // Valid once the decoder is ready
+    std::chrono::steady_clock::time_point heard;
+    std::chrono::steady_clock::time_point retry;
+    std::chrono::seconds backoff{1};
+  };
+
+  void Start(Source& source);
+  void Drop(Source& source);
+  bool Receive(Source& source);
+  const std::string& Name(const Source& source) const;
+
+  std::vector<Source> sources_;
+  std::uint64_t received_{0};
+  std::string buffer_;
+  // Rows of every host, ranked in Merge()
+  mutable std::vector<std::pair<const Source*, const ProcessRow*>> ranked_;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef DISKS_H
+#define DISKS_H
+
+#include <chrono>
+#include <vector>
+
+#include "linux_parser.h"
+#include "snapshot.h"
+
+// Per-device throughput, IOPS and utilization from /proc/diskstats, as
+// deltas between successive Update() calls
+class Disks {
+ public:
+  // Read /proc/diskstats once; devices seen for the first time show zeros
+  void Update();
+  const std::vector<DiskRow>& Rows() const;
+
+ private:
+  std::vector<LinuxParser::DiskStat> previous_ = {};
+  std::chrono::steady_clock::time_point time_ = {};
+  std::vector<DiskRow> rows_ = {};
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "snapshot.h"
+#include "system.h"
+
+/*
+Non-interactive front end: streams samples as NDJSON (one object per sample)
+or CSV (one line per process row, system columns repeated) for collectors
+that have no TTY. A fleet's merged samples (see Aggregator) are NDJSON only,
+since CSV has no column for a process's host. Each sample is serialized
+into a reused buffer and emitted with a single write, so steady-state
+output doesn't allocate.
+*/
+class Exporter {
+ public:
+  enum class Format { kNdjson, kCsv };
+
+  Exporter(std::FILE* out, Format format);
+
+  // Sample every `interval` and write `rows` processes per sample; a count
+  // of 0 runs until the process is killed. Returns false on a write error.
+  bool Run(System& system, std::size_t rows, std::chrono::milliseconds interval,
+           long count);
+  bool Write(const Snapshot& snapshot, long long timestamp_ms);
+
+ private:
+  void WriteNdjson(const Snapshot& snapshot, long long timestamp_ms);
+  void WriteCsv(const Snapshot& snapshot, long long timestamp_ms);
+  void Append(std::string_view text);
+  void AppendInt(long long value);
+  void AppendFloat(double value, int precision);
+  void AppendJsonString(std::string_view text);
+  void AppendCsvString(std::string_view text);
+
+  std::FILE* out_;
+  Format format_;
+  bool header_written_{false};
+  std::string buffer_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef FD_CACHE_H
+#define FD_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+/*
+Keeps /proc/[pid]/stat and /proc/[pid]/status open across refreshes so each
+tick costs one pread() per file instead of an open/read/close with a path
+walk through procfs. A read that fails with ESRCH means the process is gone
+and its descriptors are closed.
+
+The cache holds at most Capacity() processes, sized to stay well inside
+RLIMIT_NOFILE. When it is full, the least recently used process that was not
+read during the current tick makes room; if every cached process was read
+this tick, the new one is served uncached rather than thrashing the cache.
+
+Read() may be called from several threads as long as no two of them read the
+same pid at once, which is how System's collection workers shard the work.
+*/
+class FdCache {
+ public:
+  enum File { kStat, kStatus, kFileCount };
+
+  static FdCache& Instance();
+
+  explicit FdCache(std::size_t capacity);
+  ~FdCache();
+  FdCache(const FdCache&) = delete;
+  FdCache& operator=(const FdCache&) = delete;
+
+  // Contents of the file, in ProcReader's per-thread buffer; empty if the
+  // process does not exist
+  std::string_view Read(int pid, File file);
+  // Start a new refresh. Processes not read at all during the previous one
+  // are closed; the rest become eligible for LRU eviction.
+  void NextTick();
+  // Close the descriptors of a process known to have exited
+  void Forget(int pid);
+  std::size_t Size() const;
+  std::size_t Capacity() const;
+
+ private:
+  struct Entry {
+    int fds[kFileCount];
+    std::uint32_t tick;
+    std::list<int>::iterator lru;
+  };
+
+  Entry* Acquire(int pid);
+  void Erase(int pid);
+  void Close(Entry& entry);
+
+  mutable std::mutex mutex_;  // Guards the map and list, not the reads
+  std::size_t capacity_;
+  std::uint32_t tick_{0};
+  std::unordered_map<int, Entry> entries_;
+  std::list<int> lru_;  // Most recently used pid first
+};
+
+#endif
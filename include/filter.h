@@ -0,0 +1,126 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <vector>
+
+/*
+A process filter, parsed once and then tested against every process, e.g.
+
+  user == postgres
+  cmd ~ "java .*-Xmx" || comm == nginx
+  cpu > 5 and not state == S
+  cgroup ~ docker (mem >= 1 || uid < 1000)
+
+Fields, cheapest first:
+  uid, user   owner of /proc/[pid], one fstatat() away; where that is root,
+              as for processes that aren't dumpable, the real uid from
+              status, which the USER column shows
+  comm, state from stat, which every process read fetches
+  cpu, mem    percent of one CPU and of RAM, as the table shows them
+  cmd         the command line
+  cgroup      the cgroup path, from the unified hierarchy where there is one
+Every field takes == and !=. Text fields (user, comm, cmd, cgroup) also
+take ~ and !~ for a regular expression search, and the numbers (uid, cpu,
+mem) take <, <=, > and >=. state == DR matches either state. Terms join
+with && or "and" (or just a space), || or "or", and negate with ! or
+"not"; values with spaces or operator characters go in double quotes.
+
+Each "and" and "or" tests its terms cheapest first and stops as soon as
+the outcome is settled, and a field is only fetched when a test gets to
+it. A filter on uid or comm therefore turns most processes away before
+their cmdline, cgroup, status or io file is read. Tests on cmd, which only
+an exec changes, are remembered in a per-process Cache. An owner, comm or
+cgroup can change without one, so tests on those are only remembered while
+the caller is told of such changes (see RememberIdentity()).
+*/
+class Filter {
+ public:
+  enum class Result { kFalse, kTrue, kUnknown };
+
+  // What is known of a process; a test on anything else is kUnknown
+  struct Facts {
+    int pid{0};
+    int uid{-1};  // -1 when not looked up
+    const std::string* comm{nullptr};  // Once stat has been read
+    char state{0};  // 0 for unknown
+    float cpu{-1};  // Fraction of one CPU, -1 for unknown
+    float memory{-1};  // Fraction of RAM, -1 for unknown
+    // Whether cmd and cgroup may be read to settle a test
+    bool fetch{false};
+  };
+
+  // Outcomes of remembered tests, one bit per test. Clear it when the
+  // process execs or its pid is reused, and, while identity is remembered,
+  // when it changes owner or comm.
+  struct Cache {
+    std::uint64_t known{0};
+    std::uint64_t value{0};
+  };
+
+  // cmd and cgroup as read for a process, so that evaluating it twice in a
+  // row reads each at most once
+  struct Fetched {
+    bool command_read{false};
+    bool cgroup_read{false};
+    std::string command;
+    std::string cgroup;
+  };
+
+  // Replace the filter with text. On a syntax error the filter is left as
+  // it was and false returned, with a message in *error when given. Empty
+  // text matches every process.
+  bool Parse(const std::string& text, std::string* error);
+  const std::string& Text() const { return text_; }
+  bool Empty() const { return nodes_.empty(); }
+  // Whether a test looks at Facts::uid
+  bool UsesUid() const { return uses_uid_; }
+  // Whether tests on uid, user, comm and cgroup are remembered too, for a
+  // caller that clears a process's Cache when those change
+  void RememberIdentity(bool remember) { remember_identity_ = remember; }
+  bool RemembersIdentity() const { return remember_identity_; }
+
+  Result Evaluate(const Facts& facts, Cache& cache) const;
+  // The same, reusing what `fetched` holds; with Facts::fetch false, cmd
+  // and cgroup tests still use what an earlier evaluation read
+  Result Evaluate(const Facts& facts, Cache& cache, Fetched& fetched) const;
+
+ private:
+  // In order of cost
+  enum Field { kUid, kUser, kComm, kState, kCpu, kMemory, kCommand, kCgroup };
+  enum Op {
+    kEqual,
+    kNotEqual,
+    kMatch,
+    kNoMatch,
+    kLess,
+    kLessEqual,
+    kGreater,
+    kGreaterEqual
+  };
+  struct Node {
+    enum Kind { kAnd, kOr, kNot, kTest } kind{kTest};
+    std::vector<int> children;  // Cheapest first
+    Field field{kUid};
+    Op op{kEqual};
+    std::string text;
+    double number{0};
+    std::regex regex;
+    int cost{0};  // The dearest field in the subtree
+    int bit{-1};  // Cache bit, for tests on fields fixed until an exec
+  };
+  class Parser;
+
+  Result Evaluate(int node, const Facts& facts, Cache& cache,
+                  Fetched& fetched) const;
+  Result Test(const Node& node, const Facts& facts, Fetched& fetched) const;
+
+  std::string text_;
+  std::vector<Node> nodes_;  // The root is last
+  bool uses_uid_{false};
+  bool remember_identity_{false};
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+The monitor's own cost: time spent per phase and counts of the syscalls,
+bytes and allocations it takes. Each thread adds to a private slot, so
+instrumented code on the worker pool never contends on a shared counter;
+Read() sums the slots.
+
+Instrumentation is on unless the build sets -DMONITOR_INSTRUMENT=OFF, in
+which case MONITOR_SCOPE and MONITOR_COUNT expand to nothing and Read()
+returns zeros.
+*/
+namespace Instrument {
+#ifdef MONITOR_INSTRUMENT
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+// Phase times are inclusive: a refresh contains the stat reads it makes
+enum Phase {
+  kRefresh,
+  kPids,
+  kStat,
+  kStatus,
+  kCommand,
+  kUser,
+  kMemory,
+  kIo,
+  kSystemFiles,
+  kSort,
+  kSample,
+  kRender,
+  kPhaseCount
+};
+enum Counter { kSyscalls, kBytesRead, kAllocations, kCounterCount };
+
+struct Totals {
+  std::uint64_t calls[kPhaseCount]{};
+  std::uint64_t ns[kPhaseCount]{};
+  std::uint64_t counters[kCounterCount]{};
+  // Whole-process CPU time and peak RSS, from getrusage()
+  std::uint64_t cpu_ns{0};
+  long max_rss_kb{0};
+};
+
+void Add(Phase phase, std::uint64_t ns);
+void Count(Counter counter, std::uint64_t amount);
+Totals Read();
+// One line per phase plus a counters line, as rates over `seconds` between
+// two readings; pass a default Totals as `before` for whole-run figures
+std::vector<std::string> Report(const Totals& now, const Totals& before,
+                                double seconds);
+
+class Scope {
+ public:
+  explicit Scope(Phase phase)
+      : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+  ~Scope() {
+    Add(phase_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start_)
+                    .count());
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace Instrument
+
+#ifdef MONITOR_INSTRUMENT
+#define MONITOR_SCOPE(phase) \
+  ::Instrument::Scope instrument_scope_(::Instrument::phase)
+#define MONITOR_COUNT(counter, amount) \
+  ::Instrument::Count(::Instrument::counter, (amount))
+#else
+#define MONITOR_SCOPE(phase) static_cast<void>(0)
+#define MONITOR_COUNT(counter, amount) static_cast<void>(0)
+#endif
+
+#endif
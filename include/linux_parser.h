@@ -4,22 +4,39 @@
 #include <fstream>
 #include <regex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace LinuxParser {
-// Paths
+// Paths. Files under kProcDirectory are read relative to ProcReader::Root(),
+// which can be pointed elsewhere with SetProcDirectory().
 const std::string kProcDirectory{"/proc/"};
 const std::string kCmdlineFilename{"/cmdline"};
 const std::string kCpuinfoFilename{"/cpuinfo"};
 const std::string kStatusFilename{"/status"};
 const std::string kStatFilename{"/stat"};
+const std::string kStatmFilename{"/statm"};
+const std::string kSmapsRollupFilename{"/smaps_rollup"};
+const std::string kIoFilename{"/io"};
+const std::string kCgroupFilename{"/cgroup"};
 const std::string kUptimeFilename{"/uptime"};
 const std::string kMeminfoFilename{"/meminfo"};
+const std::string kDiskstatsFilename{"/diskstats"};
+const std::string kNetDevFilename{"/net/dev"};
 const std::string kVersionFilename{"/version"};
 const std::string kOSPath{"/etc/os-release"};
 const std::string kPasswordPath{"/etc/passwd"};
 
+bool SetProcDirectory(const std::string& path);
+
 // System
 float MemoryUtilization();
+// Used fraction and total of memory, from one read of /proc/meminfo
+struct MemInfo {
+  float utilization{0};
+  long total_kb{0};
+};
+MemInfo Memory();
 long UpTime();
 std::vector<int> Pids();
 int TotalProcesses();
@@ -27,6 +44,42 @@ int RunningProcesses();
 std::string OperatingSystem();
 std::string Kernel();
 
+// One line of /proc/diskstats; the counters are cumulative since boot
+struct DiskStat {
+  std::string name;
+  unsigned long long reads{0};
+  unsigned long long sectors_read{0};  // 512-byte units on every device
+  unsigned long long writes{0};
+  unsigned long long sectors_written{0};
+  unsigned long long io_ms{0};  // Time with at least one request in flight
+};
+
+// Whole devices, in kernel order; partitions, loop and ram disks are left out
+std::vector<DiskStat> DiskStats();
+
+// One interface's line of /proc/net/dev, for the monitor's network
+// namespace; the counters are cumulative
+struct NetDevStat {
+  std::string name;
+  unsigned long long rx_bytes{0};
+  unsigned long long rx_packets{0};
+  unsigned long long rx_errors{0};
+  unsigned long long rx_drops{0};
+  unsigned long long tx_bytes{0};
+  unsigned long long tx_packets{0};
+  unsigned long long tx_errors{0};
+  unsigned long long tx_drops{0};
+};
+
+// Shell wildcard patterns, each optionally prefixed with '!' to exclude. A
+// name is selected if it matches no exclusion and, when any pattern is an
+// inclusion, at least one inclusion.
+bool InterfaceSelected(std::string_view name,
+                       const std::vector<std::string>& patterns);
+// Selected interfaces in kernel order. Lines of the others are skipped
+// without parsing their counters.
+std::vector<NetDevStat> NetDevStats(const std::vector<std::string>& patterns);
+
 // CPU
 struct CPUStates {
   long user;
@@ -40,19 +93,22 @@ struct CPUStates {
   long guest;
   long guestnice;
 
-  long Active() { 
+  long Active() const { 
     return user + nice + system + irq + softirq + steal;
   }
 
-  long Idle() {
+  long Idle() const {
     return idle + iowait;
   }
 
-  long Total() {
+  long Total() const {
     return Active() + Idle();
   }
 };
 
+// Aggregate line at index 0, then cpuN at index N + 1 (zeros for offline
+// cores), all from a single /proc/stat read
+std::vector<CPUStates> CpuStates();
 float CpuUtilization();
 long Jiffies();
 long ActiveJiffies();
@@ -61,7 +117,137 @@ long StartTime(int pid);
 long IdleJiffies();
 
 // Processes
+
+// Every field of /proc/[pid]/stat (see proc(5)), parsed in a single read.
+// `comm` may itself contain spaces and parentheses, so it is delimited by the
+// first '(' and the last ')' of the line.
+struct ProcStat {
+  bool valid{false};
+  int pid{0};
+  std::string comm;
+  char state{'?'};
+  int ppid{0};
+  int pgrp{0};
+  int session{0};
+  int tty_nr{0};
+  int tpgid{0};
+  unsigned int flags{0};
+  unsigned long minflt{0};
+  unsigned long cminflt{0};
+  unsigned long majflt{0};
+  unsigned long cmajflt{0};
+  unsigned long utime{0};
+  unsigned long stime{0};
+  long cutime{0};
+  long cstime{0};
+  long priority{0};
+  long nice{0};
+  long num_threads{0};
+  long itrealvalue{0};
+  unsigned long long starttime{0};
+  unsigned long vsize{0};
+  long rss{0};
+  unsigned long rsslim{0};
+  unsigned long startcode{0};
+  unsigned long endcode{0};
+  unsigned long startstack{0};
+  unsigned long kstkesp{0};
+  unsigned long kstkeip{0};
+  unsigned long signal{0};
+  unsigned long blocked{0};
+  unsigned long sigignore{0};
+  unsigned long sigcatch{0};
+  unsigned long wchan{0};
+  unsigned long nswap{0};
+  unsigned long cnswap{0};
+  int exit_signal{0};
+  int processor{0};
+  unsigned int rt_priority{0};
+  unsigned int policy{0};
+  unsigned long long delayacct_blkio_ticks{0};
+  unsigned long guest_time{0};
+  long cguest_time{0};
+  unsigned long start_data{0};
+  unsigned long end_data{0};
+  unsigned long start_brk{0};
+  unsigned long arg_start{0};
+  unsigned long arg_end{0};
+  unsigned long env_start{0};
+  unsigned long env_end{0};
+  int exit_code{0};
+
+  // Jiffies spent on the CPU by the process and its waited-for children
+  long Active() const { return utime + stime + cutime + cstime; }
+  // Jiffies spent on the CPU by the process itself. Children's time only
+  // lands in cutime and cstime when they are reaped, all at once, so it
+  // has no place in a rate.
+  long Own() const { return utime + stime; }
+};
+
+ProcStat Stat(int pid);
+// One thread of a process, from /proc/[pid]/task/[tid]/stat
+ProcStat TaskStat(int pid, int tid);
+// The contents of a stat file; `valid` is false if it is malformed
+ProcStat ParseStat(std::string_view line);
+// Thread ids of a process, ascending
+std::vector<int> Tids(int pid);
+long ClockTicks();
+
+// The fields of /proc/[pid]/status the monitor uses, parsed in one read
+struct ProcStatus {
+  bool valid{false};
+  int uid{-1};  // Real uid
+};
+
+ProcStatus Status(int pid);
+std::string UserName(int uid);
+
+// /proc/[pid]/statm, in pages; all zero for kernel threads
+struct ProcStatm {
+  bool valid{false};
+  unsigned long size{0};
+  unsigned long resident{0};
+  unsigned long shared{0};
+  unsigned long text{0};
+  unsigned long data{0};
+};
+
+ProcStatm Statm(int pid);
+long PageSizeKb();
+
+// /proc/[pid]/smaps_rollup, in kB. The kernel walks every mapping to produce
+// it, so it costs far more than statm; read it only for rows on screen.
+struct ProcMemory {
+  bool valid{false};
+  long rss_kb{0};
+  long pss_kb{0};  // Shared pages split evenly between their users
+  long uss_kb{0};  // Private_Clean + Private_Dirty: freed if it exits
+  long swap_kb{0};
+  long swap_pss_kb{0};
+};
+
+ProcMemory SmapsRollup(int pid);
+
+// /proc/[pid]/io, cumulative bytes. Only readable for processes the monitor
+// could ptrace, so other users' processes come back invalid unless root.
+struct ProcIo {
+  bool valid{false};
+  unsigned long long rchar{0};  // Through read() and friends, cache included
+  unsigned long long wchar{0};
+  unsigned long long read_bytes{0};  // Fetched from storage
+  unsigned long long write_bytes{0};  // Sent, or to be sent, to storage
+  unsigned long long cancelled_write_bytes{0};
+};
+
+ProcIo Io(int pid);
+
 std::string Command(int pid);
+// Owner of /proc/[pid], with one fstatat() and no read: the effective uid,
+// or root for processes that aren't dumpable; -1 once the process is gone
+int Owner(int pid);
+// The process's cgroup path: its unified (v2) hierarchy entry, else the
+// first listed
+std::string Cgroup(int pid);
 std::string Ram(int pid);
 std::string Uid(int pid);
 std::string User(int pid);
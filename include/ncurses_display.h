@@ -3,14 +3,31 @@
 
 #include <curses.h>
 
-#include "process.h"
+#include <string>
+#include <vector>
+
+#include "aggregator.h"
+#include "recording.h"
+#include "snapshot.h"
 #include "system.h"
 
 namespace NCursesDisplay {
+// How often the render loop polls the keyboard and checks for a new frame
+const int kInputPollMs{100};
+
 void Display(System& system, int n = 10);
-void DisplaySystem(System& system, WINDOW* window);
-void DisplayProcesses(std::vector<Process>& processes, WINDOW* window, int n);
+void Replay(const Recording::Reader& recording, int n = 10);
+void Fleet(Aggregator& aggregator, int n = 10);
+void DisplaySystem(const Snapshot& snapshot, WINDOW* window);
+void DisplayDisks(const Snapshot& snapshot, WINDOW* window);
+void DisplayNetwork(const Snapshot& snapshot, WINDOW* window);
+void DisplayProcesses(const Snapshot& snapshot, WINDOW* window, int n,
+                      int selected = -1);
 std::string ProgressBar(float percent);
+void PutCell(WINDOW* window, int row, int column, int width, const char* text,
+             int attributes = 0);
+std::string CoreStrip(const std::vector<float>& cores, int first, int count);
+int CoreRows(int cores, int width);
 };  // namespace NCursesDisplay
 
 #endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "linux_parser.h"
+#include "snapshot.h"
+
+// Per-interface throughput, packet, drop and error rates from
+// /proc/net/dev, as deltas between successive Update() calls
+class Network {
+ public:
+  // Read /proc/net/dev once, keeping the interfaces `patterns` select (see
+  // LinuxParser::InterfaceSelected); new interfaces show zeros
+  void Update(const std::vector<std::string>& patterns);
+  const std::vector<InterfaceRow>& Rows() const;
+
+ private:
+  std::vector<LinuxParser::NetDevStat> previous_ = {};
+  std::chrono::steady_clock::time_point time_ = {};
+  std::vector<InterfaceRow> rows_ = {};
+};
+
+#endif
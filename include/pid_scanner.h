@@ -0,0 +1,60 @@
+#ifndef PID_SCANNER_H
+#define PID_SCANNER_H
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "proc_events.h"
+
+/*
+Enumerates the numeric entries of /proc with ProcReader::ListPids(), which
+parses getdents64() records in place. The pid list is kept sorted and
+diffed against the previous scan, so per-process caches can be updated for
+just the pids that appeared or went away instead of being rebuilt.
+
+A pid that exits and is reused between two scans shows up in neither
+Added() nor Removed(); callers that care compare start times.
+
+After Subscribe() the list is maintained from proc connector fork and exit
+events instead, and /proc is only read again every kRescanPeriod, or
+after events were lost, to keep the two consistent. If the connector
+fails later on, scanning every tick resumes.
+*/
+class PidScanner {
+ public:
+  // Re-read the pid list. On failure the previous list is kept, nothing is
+  // reported as added or removed, and false is returned.
+  bool Scan();
+  // Follow forks and exits through the proc connector; false, with errno
+  // set and scanning unchanged, when it isn't available
+  bool Subscribe();
+  bool Subscribed() const;
+  // Every pid from the last successful scan, ascending
+  const std::vector<int>& Pids() const;
+  // Pids that appeared or disappeared in the last scan, ascending; the first
+  // scan reports every pid as added
+  const std::vector<int>& Added() const;
+  const std::vector<int>& Removed() const;
+  // Listed pids that exec'd, changed uid or were renamed since the previous
+  // scan, ascending; only known while subscribed
+  const std::vector<int>& Changed() const;
+
+  static constexpr std::chrono::seconds kRescanPeriod{10};
+
+ private:
+  void Apply();
+  void Diff();
+
+  std::vector<int> pids_;
+  std::vector<int> previous_;
+  std::vector<int> added_;
+  std::vector<int> removed_;
+  std::vector<int> changed_;
+
+  ProcEvents events_;
+  std::vector<ProcEvents::Change> changes_;
+  std::chrono::steady_clock::time_point next_rescan_{};
+};
+
+#endif
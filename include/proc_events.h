@@ -0,0 +1,53 @@
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include <vector>
+
+/*
+Process lifecycle events from the kernel's netlink proc connector: every
+fork, exec, uid change, rename and exit system-wide, as they happen, without
+reading /proc.
+
+The kernel only delivers events to listeners in the initial user and pid
+namespaces, and before Linux 6.6 subscribing also needs CAP_NET_ADMIN; in
+a container that means --pid=host and --cap-add NET_ADMIN. Open() waits
+for the kernel to acknowledge the subscription, so it fails rather than
+going quietly deaf when either condition isn't met.
+
+The socket buffer can overflow under a fork storm. Drain() then reports
+kOverflow, and the caller has to rescan /proc to resynchronize.
+*/
+class ProcEvents {
+ public:
+  enum class Result { kOk, kOverflow, kFailed };
+
+  // A process (thread group) that was created or has exited
+  struct Change {
+    int pid;
+    bool alive;
+  };
+
+  ProcEvents() = default;
+  ~ProcEvents();
+  ProcEvents(const ProcEvents&) = delete;
+  ProcEvents& operator=(const ProcEvents&) = delete;
+
+  // Subscribe; false with errno set when the connector isn't available
+  bool Open();
+  void Close();
+  bool IsOpen() const;
+  // Read every pending event without blocking. Forks and exits are appended
+  // to `changes` in the order they happened; pids that exec'd, changed uid
+  // or renamed themselves, whose command, user or comm are now stale, are
+  // appended to `execs`.
+  Result Drain(std::vector<Change>& changes, std::vector<int>& execs);
+
+ private:
+  bool Listen(bool listen);
+  bool AwaitAck();
+
+  int fd_{-1};
+  std::vector<char> buffer_;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef PROC_READER_H
+#define PROC_READER_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/*
+Low-level /proc access without per-read heap allocation. Files are opened
+with openat() relative to a cached /proc directory descriptor and read with
+read() into a buffer owned by the calling thread. The buffer is reused by
+every read on that thread; it only grows if a file outgrows it.
+
+The views returned by the Read functions point into that buffer and stay
+valid until the same thread reads again.
+*/
+namespace ProcReader {
+// /proc/<name>, e.g. "stat" or "meminfo"; a leading '/' is ignored so the
+// LinuxParser filename constants can be passed as they are
+std::string_view Read(const char* name);
+// /proc/<pid>/<name>
+std::string_view ReadPid(int pid, const char* name);
+// Any absolute path, for files that live outside /proc
+std::string_view ReadPath(const char* path);
+// Open /proc/<pid>/<name> read-only, returning the descriptor or -1
+int OpenPid(int pid, const char* name);
+// Re-read an already open file from offset 0 with pread(). Returns an empty
+// view with errno set on failure (ESRCH once the process has exited).
+std::string_view ReadFd(int fd);
+// Replace `pids` with the all-digit subdirectory names of /proc/<directory>
+// ("." for /proc itself, "<pid>/task" for a process's threads), in
+// directory order. Uses getdents64() into a buffer owned by the thread.
+bool ListPids(const char* directory, std::vector<int>& pids);
+// Descriptor of the /proc directory that paths are resolved against
+int Root();
+// Resolve every later read against another directory laid out like /proc,
+// e.g. a synthetic tree for benchmarks. Call it before anything is read:
+// descriptors FdCache already holds still point into the old root.
+bool SetRoot(const char* path);
+
+// Writes the decimal digits of value followed by a NUL; returns the length.
+// `out` must hold at least 12 bytes.
+std::size_t FormatInt(int value, char* out);
+
+// Forward-only tokenizer over a file's contents. Numbers are parsed by hand,
+// with no locale lookups and no temporary strings.
+class Scanner {
+ public:
+  explicit Scanner(std::string_view text) : text_(text) {}
+
+  bool AtEnd() const { return pos_ >= text_.size(); }
+  std::string_view Rest() const { return text_.substr(pos_); }
+
+  void SkipSpaces();
+  // Next whitespace-separated field
+  std::string_view Field();
+  void SkipFields(int count);
+  long long Long();
+  unsigned long long ULong();
+  // Number with an optional fraction, e.g. the seconds in /proc/uptime
+  double Double();
+  // Rest of the current line, consuming the newline
+  std::string_view Line();
+  // Advance past the next line that starts with `key` and return true,
+  // leaving the scanner just after the key
+  bool SeekKey(std::string_view key);
+
+ private:
+  std::string_view text_;
+  std::size_t pos_{0};
+};
+}  // namespace ProcReader
+
+#endif
@@ -2,6 +2,8 @@
 #define PROCESS_H
 
 #include <string>
+
+#include "linux_parser.h"
 /*
 Basic class for Process representation
 It contains relevant attributes as shown below
@@ -9,17 +11,36 @@ It contains relevant attributes as shown below
 class Process {
  public:
   void setPid(int pid);
+  // Re-read /proc/[pid]/stat once; the getters below use this snapshot
+  void Refresh(long system_uptime);
   int Pid() const;                               // TODO: See src/process.cpp
   std::string User();                      // TODO: See src/process.cpp
   std::string Command();                   // TODO: See src/process.cpp
   float CpuUtilization() const;                  // TODO: See src/process.cpp
+  void setCpuUtilization(float utilization);
   std::string Ram();                       // TODO: See src/process.cpp
+  // Resident set size, from the stat snapshot
+  long RssKb() const;
   long int UpTime() const;                       // TODO: See src/process.cpp
+  const LinuxParser::ProcStat& Stat() const;
+  // /proc/[pid]/status, read on first use
+  const LinuxParser::ProcStatus& Status();
+  // /proc/[pid]/io is only read on request, for rows or when sorting by I/O
+  void RefreshIo();
+  const LinuxParser::ProcIo& Io() const;
   bool operator<(Process const& a) const;  // TODO: See src/process.cpp
 
   // TODO: Declare any necessary private members
  private:
+    float ComputeCpuUtilization() const;
+
     int pid_;
+    long system_uptime_{0};
+    LinuxParser::ProcStat stat_{};
+    bool status_loaded_{false};
+    LinuxParser::ProcStatus status_{};
+    float cpu_{0};  // Sort key: lifetime average until an interval is known
+    LinuxParser::ProcIo io_{};
 };
 
-#endif
\ No newline at end of file
+#endif
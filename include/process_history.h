@@ -0,0 +1,45 @@
+#ifndef PROCESS_HISTORY_H
+#define PROCESS_HISTORY_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+Previous CPU sample of every live process, used to turn cumulative jiffies
+into interval utilization. It is a flat open-addressing table keyed by pid;
+each slot also remembers the process start time so that a recycled pid is
+treated as a new process rather than as a jump in the old one's counters.
+*/
+class ProcessHistory {
+ public:
+  explicit ProcessHistory(std::size_t capacity = 1024);
+
+  // Record a sample taken at `now` (seconds, monotonic). When a previous
+  // sample of the same process exists, stores the fraction of one CPU used
+  // in between into `utilization` and returns true.
+  bool Update(int pid, unsigned long long starttime, long active_jiffies,
+              double now, float* utilization);
+  // Whether a sample of this process is held
+  bool Contains(int pid, unsigned long long starttime) const;
+  // Drop the sample of a pid that has left /proc
+  void Forget(int pid);
+  std::size_t Size() const;
+
+ private:
+  struct Slot {
+    int pid;  // 0 marks an empty slot; pid 0 never shows up in /proc
+    unsigned long long starttime;
+    long active_jiffies;
+    double time;
+  };
+
+  std::size_t Find(int pid) const;
+  void Erase(std::size_t index);
+  void Grow();
+
+  std::vector<Slot> slots_;
+  std::size_t mask_;
+  std::size_t size_{0};
+};
+
+#endif
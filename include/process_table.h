@@ -0,0 +1,135 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "filter.h"
+#include "process.h"
+#include "snapshot.h"
+
+/*
+The processes System tracks, stored column by column. The loops that run
+over every process each tick (utilization, sort keys, scheduling) walk
+contiguous arrays of plain numbers, which the compiler can vectorize; the
+Process objects, with the stat snapshot rows are displayed from, sit in a
+column of their own and are only touched for processes that are read.
+
+Rows are unordered and reused across ticks. Removing a pid moves the last
+row into its place, so nothing else shifts, and an index maps pids to rows.
+The columns are public for the loops' sake; only Add() and Remove() may
+change their length.
+
+With the tree on, rows are also linked under their parents and carry totals
+over their subtrees. Links and totals are kept up to date as rows are read,
+added and removed: a change to one row's figures is added to its ancestors,
+so the cost follows the rows that changed, not the size of the table.
+*/
+class ProcessTable {
+ public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  std::size_t Size() const { return pid.size(); }
+  // Row of a pid, or npos
+  std::size_t Find(int pid) const;
+  // Append a row for a pid that was never read; returns the row
+  std::size_t Add(int pid);
+  void Remove(int pid);
+  void Clear();
+
+  // Take a row's fresh stat read, made through process[row], into the
+  // columns; the previous read becomes the baseline for utilization
+  void Record(std::size_t row, double now);
+  // Take process[row]'s fresh io read. Rates are set when the previous read
+  // was at most max_gap ticks before `tick`, and cleared otherwise.
+  void RecordIo(std::size_t row, double now, unsigned long tick,
+                unsigned long max_gap);
+  // Utilization and memory share of every row, from the recorded reads
+  void ComputeUtilization(float clock_ticks, float memory_pages);
+  // The sort key of every row, largest first; with the tree on, the key
+  // covers the row's whole subtree
+  void ComputeKeys(SortKey sort);
+
+  // Turning the tree on links every row from its last read
+  void EnableTree(bool enabled);
+  bool TreeEnabled() const { return tree_; }
+  // Move a row under the row of its recorded ppid, or make it a root when
+  // that process isn't tracked or can't be its parent
+  void Link(std::size_t row);
+  // Carry the change in a row's own figures since its last accounting into
+  // its subtree total and those of its ancestors. Rows not shown count as
+  // nothing, so with a filter the totals cover the matching processes.
+  void Account(std::size_t row);
+
+  // Figures summed over a process and its descendants. RSS counts shared
+  // pages once per process, as the per-process figure does.
+  struct Totals {
+    double cpu{0};
+    double rss{0};  // Pages
+    double read_rate{0};
+    double write_rate{0};
+    double processes{0};
+    void Add(const Totals& other, double scale = 1);
+  };
+
+  // Identity and the two latest stat reads
+  std::vector<int> pid;
+  std::vector<unsigned char> valid;  // Whether the last stat read succeeded
+  std::vector<unsigned long long> starttime;
+  // Counters are held as doubles, exact to 2^53, so the loops over them
+  // convert nothing: SSE has no instruction from 64-bit integers
+  std::vector<double> active;  // Jiffies, see LinuxParser::ProcStat::Own()
+  std::vector<double> active_before;
+  std::vector<double> time;  // Monotonic seconds of the read, 0 for none
+  std::vector<double> time_before;
+  std::vector<double> rss;  // Pages
+  // Derived each tick
+  std::vector<float> lifetime;  // Average since start, for the first read
+  std::vector<float> cpu;  // Fraction of one CPU
+  std::vector<float> memory;  // Fraction of RAM
+  std::vector<float> key;
+  // Storage I/O: cumulative bytes at the last io read and rates since the
+  // one before, -1 when unknown
+  std::vector<unsigned long long> io_read;
+  std::vector<unsigned long long> io_write;
+  std::vector<double> io_time;
+  std::vector<unsigned long> io_tick;  // 0 for never
+  std::vector<float> read_rate;
+  std::vector<float> write_rate;
+  // Refresh schedule, in ticks
+  std::vector<unsigned long> read;  // Last stat read, 0 for never
+  std::vector<unsigned long> due;  // 0 for at once
+  std::vector<unsigned long> interval;
+  // Filtering. An excluded row failed the filter on fields other than
+  // state, cpu and mem, and isn't read again until it execs or reaches the
+  // staleness bound; shown is whether the row passed the whole filter at
+  // its last read.
+  std::vector<int> uid;  // Owner, -1 until looked up
+  std::vector<Filter::Cache> filter;
+  std::vector<unsigned char> excluded;
+  std::vector<unsigned char> shown;
+  // Process tree, as pids with 0 for none, and what each row contributes
+  // to its ancestors' totals; only kept while the tree is on
+  std::vector<int> ppid;  // From the last stat read
+  std::vector<int> parent;
+  std::vector<int> first_child;
+  std::vector<int> next_sibling;
+  std::vector<int> previous_sibling;
+  std::vector<Totals> own;
+  std::vector<Totals> subtree;
+  // Everything else a row shows
+  std::vector<Process> process;
+
+ private:
+  template <typename Function>
+  void ForEachColumn(Function function);
+  // Add to the totals of every ancestor of a row; -1 subtracts
+  void AddToAncestors(std::size_t row, const Totals& totals, double scale);
+  void Unlink(std::size_t row);
+
+  std::unordered_map<int, std::size_t> rows_;
+  bool tree_{false};
+};
+
+#endif
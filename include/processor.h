@@ -1,12 +1,30 @@
 #ifndef PROCESSOR_H
 #define PROCESSOR_H
 
+#include <vector>
+
+#include "linux_parser.h"
+
 class Processor {
  public:
+  // Read /proc/stat once and compute utilization since the previous Update()
+  void Update();
   float Utilization();  // TODO: See src/processor.cpp
+  int Cores() const;
+  float CoreUtilization(int core) const;
+  // Shares of the aggregate interval spent in iowait, steal and irq/softirq
+  float Iowait() const;
+  float Steal() const;
+  float Irq() const;
 
   // TODO: Declare any necessary private members
  private:
+  // Index 0 is the aggregate, index N + 1 is core N
+  std::vector<LinuxParser::CPUStates> previous_ = {};
+  std::vector<float> utilization_ = {};
+  float iowait_{0};
+  float steal_{0};
+  float irq_{0};
 };
 
-#endif
\ No newline at end of file
+#endif
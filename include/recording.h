@@ -0,0 +1,109 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "snapshot.h"
+
+/*
+Flight-recorder file: a versioned header followed by a ring of fixed-size
+snapshot records, memory-mapped by both the writer and the reader. Records
+are plain structs with explicit widths, so a reader uses them in place
+without parsing. The layout is host-endian; recordings are meant to be
+replayed on the machine (or architecture) that made them.
+*/
+namespace Recording {
+constexpr std::uint32_t kMagic{0x524e4f4d};  // "MONR"
+constexpr std::uint32_t kVersion{1};
+constexpr int kMaxCores{256};
+constexpr int kMaxProcesses{32};
+
+struct ProcessRecord {
+  std::int32_t pid;
+  float cpu;
+  std::int64_t uptime;
+  std::int64_t ram_mb;
+  char user[32];
+  char command[136];
+};
+
+struct SnapshotRecord {
+  std::int64_t timestamp_ms;
+  std::int64_t uptime;
+  float cpu;
+  float iowait;
+  float steal;
+  float irq;
+  float memory;
+  std::int32_t total_processes;
+  std::int32_t running_processes;
+  std::uint16_t core_count;
+  std::uint16_t process_count;
+  char os[64];
+  char kernel[64];
+  float cores[kMaxCores];
+  ProcessRecord processes[kMaxProcesses];
+};
+
+struct Header {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint32_t capacity;  // Records in the ring
+  // Records ever appended; the newest is at (written - 1) % capacity. Only
+  // advanced after the record itself is complete.
+  std::uint64_t written;
+  std::uint64_t reserved[5];
+};
+
+// Appends snapshots to a ring file of bounded size
+class Writer {
+ public:
+  Writer() = default;
+  ~Writer();
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  // Create the file, or continue a compatible existing one, sized to hold as
+  // many records as fit in `bytes`. Returns false with errno set on failure.
+  bool Open(const std::string& path, std::size_t bytes);
+  void Append(const Snapshot& snapshot, std::int64_t timestamp_ms);
+
+ private:
+  Header* header_{nullptr};
+  SnapshotRecord* records_{nullptr};
+  std::size_t length_{0};
+};
+
+// Read-only view of a recording, oldest record first. The file may still be
+// being recorded, so records are copied out and checked against the writer
+// rather than used in place.
+class Reader {
+ public:
+  Reader() = default;
+  ~Reader();
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  // Returns false if the file can't be mapped or isn't a recording of this
+  // version
+  bool Open(const std::string& path);
+  std::size_t Count() const;
+  // Copy the record at `index`; false if there is none, if the writer
+  // wrapped the ring onto it during the copy, in which case what was
+  // copied is torn, or if its counts overrun its arrays
+  bool Read(std::size_t index, SnapshotRecord& record) const;
+
+ private:
+  const Header* header_{nullptr};
+  const SnapshotRecord* records_{nullptr};
+  std::size_t length_{0};
+};
+
+// Expand a record into the form the display draws
+void ToSnapshot(const SnapshotRecord& record, Snapshot& snapshot);
+}  // namespace Recording
+
+#endif
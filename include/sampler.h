@@ -0,0 +1,68 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "snapshot.h"
+#include "system.h"
+
+/*
+Samples the system on a background thread at a fixed period and hands each
+snapshot to the render thread without locks.
+
+Three snapshot buffers rotate between the two threads: the sampler fills its
+back buffer and swaps it into the shared slot with one atomic exchange; the
+renderer swaps its front buffer out of the same slot when the slot holds an
+unread snapshot. Neither side ever touches a buffer the other one owns, and
+buffers are recycled so steady-state sampling doesn't allocate.
+*/
+class Sampler {
+ public:
+  Sampler(System& system, std::size_t rows, std::chrono::milliseconds period);
+  ~Sampler();
+  Sampler(const Sampler&) = delete;
+  Sampler& operator=(const Sampler&) = delete;
+
+  void Start();
+  void Stop();
+  // The newest snapshot if one arrived since the last call, else nullptr.
+  // The pointer stays valid until the next call.
+  const Snapshot* Latest();
+  // New System::Options, applied before an immediate sample
+  void SetOptions(System::Options options);
+  // The options last set, less the expanded and collapsed pids that have
+  // since exited; change these rather than a copy kept from before
+  System::Options Options();
+
+ private:
+  void Run();
+
+  static constexpr std::uintptr_t kFresh = 1;
+
+  System& system_;
+  std::size_t rows_;
+  std::chrono::milliseconds period_;
+
+  Snapshot buffers_[3];
+  Snapshot* back_;   // Owned by the sampler thread
+  Snapshot* front_;  // Owned by the render thread
+  // The middle buffer, tagged with kFresh while it holds an unread snapshot
+  std::atomic<std::uintptr_t> ready_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  // Set by the render thread, pruned by the sampler; guarded by mutex_
+  System::Options options_;
+  bool resample_{false};
+};
+
+#endif
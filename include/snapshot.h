@@ -0,0 +1,101 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+// Order of the process table
+enum class SortKey { kCpu, kMemory, kIo };
+
+// A thread of an expanded process
+struct ThreadRow {
+  int tid{0};
+  std::string name;
+  char state{'?'};
+  float cpu{0};
+};
+
+// One displayed row of the process table
+struct ProcessRow {
+  int pid{0};
+  std::string user;
+  float cpu{0};
+  float memory{0};  // Fraction of RAM resident
+  std::string ram;  // Resident MB
+  long rss_kb{0};
+  // From smaps_rollup when detailed memory is on, else -1
+  long pss_kb{-1};
+  long uss_kb{-1};
+  long swap_kb{-1};
+  // Bytes per second to and from storage since the previous sample; -1 on
+  // a process's first sample or when its io file can't be read
+  float read_rate{-1};
+  float write_rate{-1};
+  long uptime{0};
+  std::string command;
+  // Fleet view only: the agent the process was reported by
+  std::string host;
+  // Tree mode only: nesting below the roots, and totals over the process
+  // and its descendants
+  int depth{0};
+  int descendants{0};  // Those that match the filter
+  bool collapsed{false};
+  bool matches{true};  // False for an ancestor listed for its descendants
+  float subtree_cpu{0};
+  long subtree_rss_kb{0};
+  float subtree_read_rate{0};
+  float subtree_write_rate{0};
+  // Busiest first; only filled for processes expanded in the UI
+  std::vector<ThreadRow> threads;
+};
+
+// One block device, as rates over the interval since the previous sample
+struct DiskRow {
+  std::string name;
+  float read_rate{0};  // Bytes per second
+  float write_rate{0};
+  float iops{0};
+  float utilization{0};  // Fraction of the interval with I/O in flight
+};
+
+// One network interface, as rates per second since the previous sample
+struct InterfaceRow {
+  std::string name;
+  float rx_rate{0};  // Bytes
+  float tx_rate{0};
+  float rx_packets{0};
+  float tx_packets{0};
+  float drops{0};  // Received and transmitted together
+  float errors{0};
+};
+
+/*
+Everything one frame shows, captured by System::Sample(). Once published a
+snapshot is never modified, so the render side can read it without locking.
+*/
+struct Snapshot {
+  std::string os;
+  std::string kernel;
+  float cpu{0};
+  // In the fleet view, each host's CPU in the order of `hosts`
+  std::vector<float> cores;
+  // Fleet view only: the agents connected
+  std::vector<std::string> hosts;
+  float iowait{0};
+  float steal{0};
+  float irq{0};
+  float memory{0};
+  int total_processes{0};
+  int running_processes{0};
+  long uptime{0};
+  SortKey sort{SortKey::kCpu};
+  bool detailed_memory{false};
+  // Processes are in tree order, with subtree totals
+  bool tree{false};
+  std::vector<ProcessRow> processes;
+  std::vector<DiskRow> disks;
+  // Busiest first
+  std::vector<InterfaceRow> interfaces;
+};
+
+#endif
@@ -1,27 +1,119 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <cstddef>
+#include <limits>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "disks.h"
+#include "filter.h"
+#include "network.h"
 #include "process.h"
+#include "pid_scanner.h"
+#include "process_history.h"
+#include "process_table.h"
 #include "processor.h"
+#include "snapshot.h"
+#include "worker_pool.h"
 
 class System {
  public:
   Processor& Cpu();                   // TODO: See src/system.cpp
-  std::vector<Process>& Processes();  // TODO: See src/system.cpp
+  // Rows of Table() holding live processes, the top_n first by the sort
+  // key and the rest unordered. In tree mode only the top_n are returned,
+  // depth first with each level ordered by subtree totals. Each refresh
+  // only re-reads the processes that are due (see Options).
+  const std::vector<std::size_t>& Processes(
+      std::size_t top_n = std::numeric_limits<std::size_t>::max());
+  const ProcessTable& Table() const;
   float MemoryUtilization();          // TODO: See src/system.cpp
   long UpTime();                      // TODO: See src/system.cpp
   int TotalProcesses();               // TODO: See src/system.cpp
   int RunningProcesses();             // TODO: See src/system.cpp
   std::string Kernel();               // TODO: See src/system.cpp
   std::string OperatingSystem();      // TODO: See src/system.cpp
+  // Refresh everything and capture it, with the top `rows` processes, into
+  // snapshot; the snapshot's strings and vectors are reused
+  void Sample(Snapshot& snapshot, std::size_t rows);
+  // Track process creation and exit through the proc connector instead of
+  // scanning /proc every refresh; false, with errno set, if unavailable
+  bool UseProcEvents();
+  // What Sample() collects and how it orders the rows
+  struct Options {
+    SortKey sort{SortKey::kCpu};
+    // Read smaps_rollup for PSS, USS and swap of the rows
+    bool detailed_memory{false};
+    // Processes whose threads are listed, when they are among the rows
+    std::vector<int> expanded;
+    // Network interfaces to list, as LinuxParser::InterfaceSelected()
+    // patterns; container hosts can have hundreds of veth pairs
+    std::vector<std::string> interfaces{"!veth*"};
+    // Processes that used no CPU since their last read are re-read at
+    // doubling intervals, but at least every max_staleness refreshes; 1
+    // re-reads every process on every refresh
+    int max_staleness{8};
+    // Most processes re-read per refresh beyond those that must be (new,
+    // shown, expanded or at the staleness bound); 0 for no limit
+    int refresh_budget{0};
+    // List processes under their parents, with totals over each subtree
+    bool tree{false};
+    // Processes whose descendants are hidden in tree mode
+    std::vector<int> collapsed;
+    // Only list processes that match this Filter text, which should have
+    // been checked with Filter::Parse(); text that doesn't parse matches
+    // every process
+    std::string filter;
+  };
+  void SetOptions(Options options);
+  const Options& GetOptions() const;
+  // Threads used to collect per-process data; 1 collects on the caller
+  void SetThreads(int threads);
+  int Threads() const;
 
   // TODO: Define any necessary private members
  private:
+  // Fields that never change over a process's life, fetched the first time
+  // the process is displayed
+  struct ProcessInfo {
+    unsigned long long starttime;
+    std::string user;
+    std::string command;
+  };
+  const ProcessInfo& Info(Process& process);
+  void Schedule();
+  bool Admit(std::size_t row, bool with_stat);
+  void Judge(std::size_t row);
+  void Readmit(std::size_t row);
+  void PruneOptions();
+  void RankTree(std::size_t top_n);
+  void SampleThreads(int pid, long uptime, std::vector<ThreadRow>& threads);
+
   Processor cpu_ = {};
-  std::vector<Process> processes_ = {};
+  Disks disks_ = {};
+  Network network_ = {};
+  ProcessTable table_ = {};
+  std::vector<std::size_t> due_ = {};  // Rows read this tick
+  std::vector<std::size_t> optional_ = {};
+  std::vector<std::size_t> order_ = {};
+  std::vector<int> depth_ = {};  // Of each row of order_, in tree mode
+  std::vector<std::pair<std::size_t, int>> stack_ = {};  // Row and depth
+  std::vector<std::size_t> siblings_ = {};
+  std::vector<int> visible_ = {};  // Pids of the last Sample()'s rows
+  PidScanner pids_ = {};
+  std::unordered_map<int, ProcessInfo> info_ = {};
+  unsigned long tick_{0};  // Refreshes so far
+  long memory_total_kb_{0};  // From the last MemoryUtilization()
+  // expanded and collapsed are kept sorted, and hold live pids only
+  Options options_ = {};
+  Filter filter_ = {};  // Parsed from options_.filter
+  // Tids listed last time per expanded process, and their CPU samples
+  std::unordered_map<int, std::vector<int>> tids_ = {};
+  ProcessHistory thread_history_;
+  std::unique_ptr<WorkerPool> pool_ = std::make_unique<WorkerPool>(1);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef USER_CACHE_H
+#define USER_CACHE_H
+
+#include <sys/types.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+/*
+UID to user name map loaded from the password file in one pass. The file is
+re-parsed only when its inode, size or mtime changes, and that is checked at
+most once per second, so a lookup is normally a single hash probe.
+*/
+class UserCache {
+ public:
+  explicit UserCache(std::string path);
+
+  // Name for uid, or the numeric uid when the password file has no entry
+  std::string Name(int uid);
+
+ private:
+  void Revalidate();
+  void Load();
+
+  std::string path_;
+  std::unordered_map<int, std::string> names_;
+  dev_t device_{0};
+  ino_t inode_{0};
+  off_t size_{-1};
+  struct timespec mtime_ {};
+  std::chrono::steady_clock::time_point checked_{};
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "snapshot.h"
+
+/*
+The stream an agent serves its subscribers, and the sockets it travels on.
+
+A subscriber connects and sends a Hello; the agent then writes frames until
+the subscriber goes away. A frame is a 4-byte little-endian payload length
+and the payload, whose first byte says whether it is a keyframe or a delta.
+
+Both ends hold the snapshot last sent as an Image: the snapshot reduced to
+integers (fractions in hundredths of a percent, rates in bytes or tenths of
+a packet per second) and strings. A delta is the difference between two
+images as LEB128 varints: for each row the index of the row with the same
+key in the previous image, a bitmask of the fields that changed and the
+zigzag difference of each. A process whose figures didn't change costs two
+bytes per frame, and an unchanged string nothing. A keyframe is a delta
+from the empty image, and the decoder starts over at each one, so a
+subscriber that falls behind is resynchronized by sending it one. A
+keepalive carries nothing; it goes out when no other frame has for
+kKeepalivePeriod, so that a subscriber can tell an agent sampling at long
+intervals from one that is gone.
+*/
+namespace Wire {
+constexpr std::uint32_t kMagic{0x574e4f4d};  // "MONW"
+constexpr std::uint32_t kVersion{1};
+// Larger frames are taken for a corrupt stream
+constexpr std::uint32_t kMaxFrame{4 << 20};
+
+enum FrameType : std::uint8_t { kKeyframe = 1, kDelta = 2, kKeepalive = 3 };
+constexpr std::chrono::seconds kKeepalivePeriod{3};
+
+// What a subscriber sends first, in little-endian
+struct Hello {
+  std::uint32_t magic;
+  std::uint32_t version;
+};
+
+// Fields of one row; a table uses a prefix of each array
+constexpr int kMaxValues{17};
+constexpr int kMaxTexts{3};
+struct Row {
+  std::int64_t values[kMaxValues]{};
+  std::string texts[kMaxTexts];
+};
+
+// Rows past `count` are kept to reuse their strings
+struct Table {
+  std::vector<Row> rows;
+  std::size_t count{0};
+};
+
+struct Image {
+  Row header;  // System figures; host, OS and kernel
+  std::vector<std::int64_t> cores;
+  Table processes;
+  Table disks;
+  Table interfaces;
+};
+
+// Turns snapshots into frames, each a delta from the last
+class Encoder {
+ public:
+  explicit Encoder(std::string host) : host_(std::move(host)) {}
+
+  // Append a delta from the last snapshot encoded to `snapshot`
+  void Delta(const Snapshot& snapshot, std::string& out);
+  // Append a keyframe of the last snapshot encoded, for a subscriber that
+  // joins or rejoins the stream of deltas
+  void Keyframe(std::string& out) const;
+
+ private:
+  std::string host_;
+  Image sent_;
+  Image next_;
+};
+
+// Rebuilds snapshots from frames
+class Decoder {
+ public:
+  // Apply one frame's payload; false if it is malformed or a delta arrives
+  // before any keyframe, after which only a keyframe is accepted. A
+  // keepalive changes nothing.
+  bool Apply(std::string_view payload);
+  bool Ready() const { return ready_; }
+  const std::string& Host() const;
+  // The snapshot as of the last frame applied. Process rows have no
+  // threads, and ram is derived from rss_kb.
+  void Expand(Snapshot& snapshot) const;
+
+ private:
+  Image image_;
+  Image previous_;
+  bool ready_{false};
+};
+
+// The size of the frame at the front of `data`: 0 while it is incomplete,
+// and -1 if its length is out of bounds
+long FrameSize(std::string_view data);
+// Append a keepalive frame
+void Keepalive(std::string& out);
+
+// A Unix socket path, as "unix:PATH" or any text with a '/', or a TCP
+// "[HOST:]PORT"; a listener with no host binds to localhost only
+struct Endpoint {
+  bool local{false};
+  std::string path;
+  std::string host;
+  std::string port;
+};
+bool ParseEndpoint(const std::string& text, Endpoint& endpoint);
+// A non-blocking listening socket, or -1 with errno set. A stale socket
+// file left at a Unix path is replaced.
+int Listen(const Endpoint& endpoint);
+// A non-blocking socket with the connection started; writable once it is
+// made or has failed. A TCP host can resolve to several addresses (say ::1
+// and 127.0.0.1): the first is tried from address number `next` on that
+// can be started, and `next` is left at the one after it, or 0 when there
+// is none. -1 with errno set if none can be started.
+int Connect(const Endpoint& endpoint, std::size_t& next);
+}  // namespace Wire
+
+#endif
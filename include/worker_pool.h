@@ -0,0 +1,59 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Fixed pool of threads for data-parallel loops. ParallelFor() gives every
+participant (the calling thread included) an equal contiguous share of the
+index range. Each one takes small chunks from the front of its own share and,
+once that runs dry, steals chunks from the others, so a few slow /proc reads
+don't leave the rest of the pool idle.
+
+With one thread nothing is spawned and the loop runs inline.
+*/
+class WorkerPool {
+ public:
+  explicit WorkerPool(int threads);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  int Threads() const;
+  // Calls body(begin, end) over disjoint chunks covering [0, count), and
+  // returns once all of them have run
+  void ParallelFor(std::size_t count,
+                   const std::function<void(std::size_t, std::size_t)>& body);
+
+ private:
+  // One share of the index range; padded so cursors don't share a cache line
+  struct alignas(64) Share {
+    std::atomic<std::size_t> next{0};
+    std::size_t end{0};
+  };
+
+  void Work(int self);
+  void Loop(int self);
+
+  int threads_;
+  std::unique_ptr<Share[]> shares_;
+  std::vector<std::thread> workers_;
+  const std::function<void(std::size_t, std::size_t)>* body_{nullptr};
+  std::size_t chunk_{1};
+
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  unsigned long generation_{0};
+  int running_{0};
+  bool stopping_{false};
+};
+
+#endif
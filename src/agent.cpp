@@ -0,0 +1,220 @@
+#include "agent.h"
+
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <csignal>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+using std::size_t;
+using std::string;
+
+namespace {
+string HostName() {
+  char name[HOST_NAME_MAX + 1]{};
+  if (gethostname(name, sizeof(name) - 1) != 0) return "?";
+  return name;
+}
+
+std::uint32_t LittleEndian(const string& bytes, size_t offset) {
+  std::uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<std::uint32_t>(
+                 static_cast<unsigned char>(bytes[offset + i]))
+             << 8 * i;
+  }
+  return value;
+}
+}  // namespace
+
+Agent::Agent(System& system, size_t rows, std::chrono::milliseconds interval)
+    : system_(system), rows_(rows), interval_(interval), encoder_(HostName()) {}
+
+Agent::~Agent() {
+  for (const Subscriber& subscriber : subscribers_) close(subscriber.fd);
+  if (listener_ >= 0) close(listener_);
+  if (!path_.empty()) unlink(path_.c_str());
+}
+
+bool Agent::Listen(const Wire::Endpoint& endpoint) {
+  listener_ = Wire::Listen(endpoint);
+  if (listener_ < 0) return false;
+  if (endpoint.local) path_ = endpoint.path;
+  return true;
+}
+
+// Samples are taken against absolute deadlines, as the exporter's are, and
+// the sockets are served in between
+void Agent::Run(long count) {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  int stop = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  std::vector<pollfd> fds;
+  auto deadline = std::chrono::steady_clock::now();
+  auto keepalive = deadline + Wire::kKeepalivePeriod;
+  for (long sample = 0;;) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      if (count > 0 && sample == count) break;
+      system_.Sample(snapshot_, rows_);
+      Publish();
+      ++sample;
+      deadline += interval_;
+      // After a stall, skip the missed ticks instead of sampling back to back
+      if (deadline < now) deadline = now + interval_;
+      keepalive = now + Wire::kKeepalivePeriod;
+    } else if (now >= keepalive) {
+      Keepalive();
+      keepalive = now + Wire::kKeepalivePeriod;
+    }
+
+    // Wake for the next sample or keepalive, or the first Hello to run out
+    // of time
+    auto wake = std::min(deadline, keepalive);
+    for (Subscriber& subscriber : subscribers_) {
+      if (subscriber.subscribed) continue;
+      if (now - subscriber.accepted >= kHelloTimeout) {
+        close(subscriber.fd);
+        subscriber.fd = -1;
+        continue;
+      }
+      wake = std::min(wake, subscriber.accepted + kHelloTimeout);
+    }
+    Prune();
+
+    fds.clear();
+    fds.push_back({listener_, POLLIN, 0});
+    fds.push_back({stop, POLLIN, 0});
+    for (const Subscriber& subscriber : subscribers_) {
+      short events = subscriber.pending.empty() ? POLLIN : POLLIN | POLLOUT;
+      fds.push_back({subscriber.fd, events, 0});
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+        wake - std::chrono::steady_clock::now());
+    if (poll(fds.data(), fds.size(), std::max<long>(0, wait.count())) < 0) {
+      continue;  // EINTR
+    }
+    if (fds[1].revents & POLLIN) break;
+
+    // Subscribers accepted now aren't in fds yet
+    size_t polled = subscribers_.size();
+    if (fds[0].revents & POLLIN) Accept();
+    for (size_t i = 0; i < polled; ++i) {
+      Subscriber& subscriber = subscribers_[i];
+      short events = fds[i + 2].revents;
+      bool alive = true;
+      if (events & (POLLIN | POLLHUP | POLLERR)) alive = Receive(subscriber);
+      if (alive && (events & POLLOUT)) alive = Flush(subscriber);
+      if (!alive) {
+        close(subscriber.fd);
+        subscriber.fd = -1;
+      }
+    }
+    Prune();
+  }
+  if (stop >= 0) close(stop);
+}
+
+// Only to subscribers that took the last frame whole; the others are
+// waited on anyway
+void Agent::Keepalive() {
+  if (keepalive_.empty()) Wire::Keepalive(keepalive_);
+  for (Subscriber& subscriber : subscribers_) {
+    if (!subscriber.subscribed || !subscriber.pending.empty()) continue;
+    if (!Send(subscriber, keepalive_)) {
+      close(subscriber.fd);
+      subscriber.fd = -1;
+    }
+  }
+  Prune();
+}
+
+// Forget the subscribers whose sockets were closed
+void Agent::Prune() {
+  subscribers_.erase(
+      std::remove_if(subscribers_.begin(), subscribers_.end(),
+                     [](const Subscriber& s) { return s.fd < 0; }),
+      subscribers_.end());
+}
+
+void Agent::Accept() {
+  while (true) {
+    int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    Subscriber subscriber;
+    subscriber.fd = fd;
+    subscriber.accepted = std::chrono::steady_clock::now();
+    subscribers_.push_back(std::move(subscriber));
+  }
+}
+
+// A subscriber says nothing after its Hello; anything more is read and
+// dropped, so only a hangup is noticed
+bool Agent::Receive(Subscriber& subscriber) {
+  char buffer[256];
+  ssize_t count = recv(subscriber.fd, buffer, sizeof(buffer), 0);
+  if (count == 0) return false;
+  if (count < 0) return errno == EAGAIN || errno == EINTR;
+  if (subscriber.subscribed) return true;
+  size_t missing = sizeof(Wire::Hello) - subscriber.hello.size();
+  subscriber.hello.append(buffer, std::min<size_t>(count, missing));
+  if (subscriber.hello.size() < sizeof(Wire::Hello)) return true;
+  if (LittleEndian(subscriber.hello, 0) != Wire::kMagic ||
+      LittleEndian(subscriber.hello, 4) != Wire::kVersion) {
+    return false;
+  }
+  subscriber.subscribed = true;
+  // Joins the stream at once if there is anything to show
+  subscriber.behind = true;
+  return !encoded_ || Flush(subscriber);
+}
+
+// Write a frame, keeping whatever the socket doesn't take
+bool Agent::Send(Subscriber& subscriber, const string& frame) {
+  ssize_t sent = send(subscriber.fd, frame.data(), frame.size(), MSG_NOSIGNAL);
+  if (sent < 0) {
+    if (errno != EAGAIN && errno != EINTR) return false;
+    sent = 0;
+  }
+  subscriber.pending.assign(frame, sent, string::npos);
+  return true;
+}
+
+// Send what the socket didn't take before, then the keyframe owed, if any
+bool Agent::Flush(Subscriber& subscriber) {
+  if (!subscriber.pending.empty()) {
+    ssize_t sent = send(subscriber.fd, subscriber.pending.data(),
+                        subscriber.pending.size(), MSG_NOSIGNAL);
+    if (sent < 0) return errno == EAGAIN || errno == EINTR;
+    subscriber.pending.erase(0, sent);
+    if (!subscriber.pending.empty()) return true;
+  }
+  if (!subscriber.behind || !encoded_) return true;
+  if (keyframe_.empty()) encoder_.Keyframe(keyframe_);
+  subscriber.behind = false;
+  return Send(subscriber, keyframe_);
+}
+
+void Agent::Publish() {
+  delta_.clear();
+  keyframe_.clear();
+  encoder_.Delta(snapshot_, delta_);
+  encoded_ = true;
+  for (Subscriber& subscriber : subscribers_) {
+    if (!subscriber.subscribed) continue;
+    // The delta only applies to the frame before, which must have gone
+    // out whole
+    if (!subscriber.pending.empty()) subscriber.behind = true;
+    bool alive = subscriber.behind ? Flush(subscriber) : Send(subscriber, delta_);
+    if (!alive) {
+      close(subscriber.fd);
+      subscriber.fd = -1;
+    }
+  }
+  Prune();
+}
@@ -0,0 +1,242 @@
+#include "aggregator.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+
+using std::size_t;
+using std::string;
+
+namespace {
+constexpr size_t kReadBuffer = 64 * 1024;
+
+float Key(const ProcessRow& row, SortKey sort) {
+  switch (sort) {
+    case SortKey::kCpu:
+      return row.cpu;
+    case SortKey::kMemory:
+      return row.rss_kb;
+    case SortKey::kIo:
+      return std::max(0.0f, row.read_rate) + std::max(0.0f, row.write_rate);
+  }
+  return 0;
+}
+}  // namespace
+
+bool Aggregator::Add(const string& target) {
+  Source source;
+  size_t equals = target.find('=');
+  if (equals != string::npos) source.name = target.substr(0, equals);
+  string address = equals == string::npos ? target : target.substr(equals + 1);
+  if (!Wire::ParseEndpoint(address, source.endpoint)) return false;
+  sources_.push_back(std::move(source));
+  return true;
+}
+
+bool Aggregator::Poll(int timeout_ms) {
+  auto now = std::chrono::steady_clock::now();
+  for (Source& source : sources_) {
+    if (source.fd < 0 && now >= source.retry) Start(source);
+  }
+  size_t connected = Connected();
+
+  std::vector<pollfd> fds;
+  std::vector<Source*> polled;
+  for (Source& source : sources_) {
+    if (source.fd < 0) continue;
+    short events = source.connecting ? POLLOUT : POLLIN;
+    fds.push_back({source.fd, events, 0});
+    polled.push_back(&source);
+  }
+  if (poll(fds.data(), fds.size(), timeout_ms) < 0) return false;
+
+  bool changed = false;
+  now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < fds.size(); ++i) {
+    Source& source = *polled[i];
+    if (fds[i].revents == 0) continue;
+    if (!source.connecting) {
+      changed = Receive(source) || changed;
+      continue;
+    }
+    // The connection is made, or has failed
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(source.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    unsigned char hello[sizeof(Wire::Hello)];
+    for (int byte = 0; byte < 4; ++byte) {
+      hello[byte] = Wire::kMagic >> 8 * byte;
+      hello[4 + byte] = Wire::kVersion >> 8 * byte;
+    }
+    if (error != 0 && source.address != 0) {
+      // Try the host's next address at once
+      close(source.fd);
+      Start(source);
+      continue;
+    }
+    if (error != 0 || send(source.fd, hello, sizeof(hello), MSG_NOSIGNAL) !=
+                          static_cast<ssize_t>(sizeof(hello))) {
+      Drop(source);
+      continue;
+    }
+    source.connecting = false;
+    source.address = 0;
+    source.heard = now;
+  }
+  for (Source& source : sources_) {
+    if (source.fd >= 0 && now - source.heard > kSilence) Drop(source);
+  }
+  return changed || Connected() != connected;
+}
+
+void Aggregator::Start(Source& source) {
+  source.heard = std::chrono::steady_clock::now();
+  source.fd = Wire::Connect(source.endpoint, source.address);
+  source.connecting = source.fd >= 0;
+  if (source.fd < 0) Drop(source);
+}
+
+void Aggregator::Drop(Source& source) {
+  if (source.fd >= 0) close(source.fd);
+  source.fd = -1;
+  source.connecting = false;
+  source.input.clear();
+  source.decoder = Wire::Decoder();
+  source.retry = std::chrono::steady_clock::now() + source.backoff;
+  source.backoff = std::min(source.backoff * 2, kMaxBackoff);
+}
+
+// Everything that has arrived, applied frame by frame; the snapshot is
+// only expanded once, from the last
+bool Aggregator::Receive(Source& source) {
+  buffer_.resize(kReadBuffer);
+  while (true) {
+    ssize_t count = recv(source.fd, buffer_.data(), buffer_.size(), 0);
+    if (count > 0) {
+      source.input.append(buffer_.data(), count);
+      received_ += count;
+      continue;
+    }
+    if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+      Drop(source);
+      return false;
+    }
+    if (errno == EAGAIN) break;
+  }
+  std::string_view input = source.input;
+  bool framed = false;
+  bool applied = false;
+  while (long size = Wire::FrameSize(input)) {
+    std::string_view payload =
+        input.substr(4, std::max<long>(0, size - 4));
+    if (size < 0 || !source.decoder.Apply(payload)) {
+      Drop(source);
+      return false;
+    }
+    input.remove_prefix(size);
+    framed = true;
+    applied = applied || payload[0] != Wire::kKeepalive;
+  }
+  source.input.erase(0, source.input.size() - input.size());
+  if (!framed) return false;
+  source.heard = std::chrono::steady_clock::now();
+  source.backoff = std::chrono::seconds(1);
+  if (!applied || !source.decoder.Ready()) return false;
+  source.decoder.Expand(source.snapshot);
+  return true;
+}
+
+size_t Aggregator::Connected() const {
+  return std::count_if(sources_.begin(), sources_.end(),
+                       [](const Source& source) {
+                         return source.fd >= 0 && source.decoder.Ready();
+                       });
+}
+
+const string& Aggregator::Name(const Source& source) const {
+  return source.name.empty() ? source.decoder.Host() : source.name;
+}
+
+void Aggregator::Merge(Snapshot& snapshot, size_t rows, SortKey sort) const {
+  snapshot.hosts.clear();
+  snapshot.cores.clear();
+  snapshot.disks.clear();
+  snapshot.interfaces.clear();
+  snapshot.os.clear();
+  snapshot.kernel.clear();
+  snapshot.total_processes = snapshot.running_processes = 0;
+  snapshot.uptime = 0;
+  snapshot.detailed_memory = false;
+  ranked_.clear();
+  double cpu = 0, iowait = 0, steal = 0, irq = 0, memory = 0, cores = 0;
+  for (const Source& source : sources_) {
+    if (source.fd < 0 || !source.decoder.Ready()) continue;
+    const Snapshot& host = source.snapshot;
+    const string& name = Name(source);
+    double weight = std::max<size_t>(1, host.cores.size());
+    cpu += host.cpu * weight;
+    iowait += host.iowait * weight;
+    steal += host.steal * weight;
+    irq += host.irq * weight;
+    cores += weight;
+    memory += host.memory;
+    snapshot.total_processes += host.total_processes;
+    snapshot.running_processes += host.running_processes;
+    snapshot.uptime = std::max(snapshot.uptime, host.uptime);
+    snapshot.detailed_memory = snapshot.detailed_memory || host.detailed_memory;
+    // The hosts' own, while they all agree
+    bool first = snapshot.hosts.empty();
+    if (first || snapshot.os != host.os) snapshot.os = first ? host.os : "mixed";
+    if (first || snapshot.kernel != host.kernel) {
+      snapshot.kernel = first ? host.kernel : "mixed";
+    }
+    snapshot.hosts.push_back(name);
+    snapshot.cores.push_back(host.cpu);
+    for (const ProcessRow& row : host.processes) ranked_.emplace_back(&source, &row);
+    for (const DiskRow& disk : host.disks) {
+      snapshot.disks.push_back(disk);
+      snapshot.disks.back().name = name + ":" + disk.name;
+    }
+    for (const InterfaceRow& interface : host.interfaces) {
+      snapshot.interfaces.push_back(interface);
+      snapshot.interfaces.back().name = name + ":" + interface.name;
+    }
+  }
+  size_t hosts = snapshot.hosts.size();
+  snapshot.cpu = cores > 0 ? cpu / cores : 0;
+  snapshot.iowait = cores > 0 ? iowait / cores : 0;
+  snapshot.steal = cores > 0 ? steal / cores : 0;
+  snapshot.irq = cores > 0 ? irq / cores : 0;
+  snapshot.memory = hosts > 0 ? memory / hosts : 0;
+  snapshot.sort = sort;
+  snapshot.tree = false;
+
+  size_t n = std::min(rows, ranked_.size());
+  std::partial_sort(ranked_.begin(), ranked_.begin() + n, ranked_.end(),
+                    [sort](const auto& a, const auto& b) {
+                      return Key(*a.second, sort) > Key(*b.second, sort);
+                    });
+  snapshot.processes.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    ProcessRow& row = snapshot.processes[i];
+    row = *ranked_[i].second;
+    row.host = Name(*ranked_[i].first);
+    // Trees don't span hosts
+    row.depth = row.descendants = 0;
+    row.collapsed = false;
+    row.matches = true;
+  }
+  // Busiest first, as each host has its interfaces
+  std::stable_sort(snapshot.disks.begin(), snapshot.disks.end(),
+                   [](const DiskRow& a, const DiskRow& b) {
+                     return a.read_rate + a.write_rate >
+                            b.read_rate + b.write_rate;
+                   });
+  std::stable_sort(snapshot.interfaces.begin(), snapshot.interfaces.end(),
+                   [](const InterfaceRow& a, const InterfaceRow& b) {
+                     return a.rx_rate + a.tx_rate > b.rx_rate + b.tx_rate;
+                   });
+}
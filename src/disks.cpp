@@ -0,0 +1,49 @@
+#include "disks.h"
+
+#include <cstddef>
+
+using std::size_t;
+using std::vector;
+
+namespace {
+constexpr double kSectorBytes = 512;
+}  // namespace
+
+void Disks::Update() {
+  vector<LinuxParser::DiskStat> current = LinuxParser::DiskStats();
+  auto now = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(now - time_).count();
+
+  rows_.resize(current.size());
+  for (size_t i = 0; i < current.size(); ++i) {
+    const LinuxParser::DiskStat& disk = current[i];
+    DiskRow& row = rows_[i];
+    row.name = disk.name;
+    row.read_rate = row.write_rate = row.iops = row.utilization = 0;
+    // Devices keep their order, so the previous sample is usually at i
+    const LinuxParser::DiskStat* then = nullptr;
+    if (i < previous_.size() && previous_[i].name == disk.name) {
+      then = &previous_[i];
+    } else {
+      for (const LinuxParser::DiskStat& candidate : previous_) {
+        if (candidate.name == disk.name) then = &candidate;
+      }
+    }
+    // Counters go backwards only if the device was replaced in between
+    if (then == nullptr || seconds <= 0 || disk.reads < then->reads ||
+        disk.writes < then->writes) {
+      continue;
+    }
+    row.read_rate =
+        (disk.sectors_read - then->sectors_read) * kSectorBytes / seconds;
+    row.write_rate =
+        (disk.sectors_written - then->sectors_written) * kSectorBytes / seconds;
+    row.iops = (disk.reads - then->reads + disk.writes - then->writes) / seconds;
+    row.utilization = (disk.io_ms - then->io_ms) / (seconds * 1000);
+    if (row.utilization > 1) row.utilization = 1;
+  }
+  previous_ = std::move(current);
+  time_ = now;
+}
+
+const vector<DiskRow>& Disks::Rows() const { return rows_; }
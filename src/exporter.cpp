@@ -0,0 +1,282 @@
+#include "exporter.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+using std::size_t;
+using std::string_view;
+
+Exporter::Exporter(std::FILE* out, Format format)
+    : out_(out), format_(format) {
+  buffer_.reserve(64 * 1024);
+}
+
+bool Exporter::Run(System& system, size_t rows,
+                   std::chrono::milliseconds interval, long count) {
+  Snapshot snapshot;
+  auto deadline = std::chrono::steady_clock::now();
+  for (long sample = 0; count == 0 || sample < count; ++sample) {
+    if (sample > 0) {
+      deadline += interval;
+      std::this_thread::sleep_until(deadline);
+    }
+    system.Sample(snapshot, rows);
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    if (!Write(snapshot, now)) return false;
+  }
+  return true;
+}
+
+bool Exporter::Write(const Snapshot& snapshot, long long timestamp_ms) {
+  buffer_.clear();
+  if (format_ == Format::kNdjson) {
+    WriteNdjson(snapshot, timestamp_ms);
+  } else {
+    WriteCsv(snapshot, timestamp_ms);
+  }
+  // One write per sample; flushing keeps downstream collectors current
+  return std::fwrite(buffer_.data(), 1, buffer_.size(), out_) ==
+             buffer_.size() &&
+         std::fflush(out_) == 0;
+}
+
+void Exporter::WriteNdjson(const Snapshot& snapshot, long long timestamp_ms) {
+  Append("{\"timestamp_ms\":");
+  AppendInt(timestamp_ms);
+  Append(",\"cpu\":");
+  AppendFloat(snapshot.cpu, 4);
+  // A fleet has a figure per host in place of one per core
+  if (snapshot.hosts.empty()) {
+    Append(",\"cores\":[");
+    for (size_t i = 0; i < snapshot.cores.size(); ++i) {
+      if (i > 0) Append(",");
+      AppendFloat(snapshot.cores[i], 4);
+    }
+  } else {
+    Append(",\"hosts\":[");
+    for (size_t i = 0; i < snapshot.hosts.size(); ++i) {
+      Append(i > 0 ? ",{\"name\":" : "{\"name\":");
+      AppendJsonString(snapshot.hosts[i]);
+      Append(",\"cpu\":");
+      AppendFloat(snapshot.cores[i], 4);
+      Append("}");
+    }
+  }
+  Append("],\"iowait\":");
+  AppendFloat(snapshot.iowait, 4);
+  Append(",\"steal\":");
+  AppendFloat(snapshot.steal, 4);
+  Append(",\"irq\":");
+  AppendFloat(snapshot.irq, 4);
+  Append(",\"memory\":");
+  AppendFloat(snapshot.memory, 4);
+  Append(",\"total_processes\":");
+  AppendInt(snapshot.total_processes);
+  Append(",\"running_processes\":");
+  AppendInt(snapshot.running_processes);
+  Append(",\"uptime\":");
+  AppendInt(snapshot.uptime);
+  Append(",\"processes\":[");
+  for (size_t i = 0; i < snapshot.processes.size(); ++i) {
+    const ProcessRow& row = snapshot.processes[i];
+    Append(i > 0 ? ",{\"pid\":" : "{\"pid\":");
+    AppendInt(row.pid);
+    // Present in the fleet view
+    if (!row.host.empty()) {
+      Append(",\"host\":");
+      AppendJsonString(row.host);
+    }
+    Append(",\"user\":");
+    AppendJsonString(row.user);
+    Append(",\"cpu\":");
+    AppendFloat(row.cpu, 4);
+    Append(",\"memory\":");
+    AppendFloat(row.memory, 4);
+    // A number like the other figures, though the row holds it as text
+    Append(",\"ram_mb\":");
+    AppendInt(std::atol(row.ram.c_str()));
+    Append(",\"rss_kb\":");
+    AppendInt(row.rss_kb);
+    // Present only when smaps_rollup was read
+    if (row.pss_kb >= 0) {
+      Append(",\"pss_kb\":");
+      AppendInt(row.pss_kb);
+      Append(",\"uss_kb\":");
+      AppendInt(row.uss_kb);
+      Append(",\"swap_kb\":");
+      AppendInt(row.swap_kb);
+    }
+    // Present once a rate is known
+    if (row.read_rate >= 0) {
+      Append(",\"read_bps\":");
+      AppendFloat(row.read_rate, 0);
+      Append(",\"write_bps\":");
+      AppendFloat(row.write_rate, 0);
+    }
+    Append(",\"uptime\":");
+    AppendInt(row.uptime);
+    Append(",\"command\":");
+    AppendJsonString(row.command);
+    // Present in tree mode, where rows come in depth-first order
+    if (snapshot.tree) {
+      Append(",\"depth\":");
+      AppendInt(row.depth);
+      Append(",\"descendants\":");
+      AppendInt(row.descendants);
+      Append(row.matches ? ",\"matches\":true" : ",\"matches\":false");
+      Append(",\"subtree\":{\"cpu\":");
+      AppendFloat(row.subtree_cpu, 4);
+      Append(",\"rss_kb\":");
+      AppendInt(row.subtree_rss_kb);
+      Append(",\"read_bps\":");
+      AppendFloat(row.subtree_read_rate, 0);
+      Append(",\"write_bps\":");
+      AppendFloat(row.subtree_write_rate, 0);
+      Append("}");
+    }
+    Append("}");
+  }
+  Append("],\"disks\":[");
+  for (size_t i = 0; i < snapshot.disks.size(); ++i) {
+    const DiskRow& disk = snapshot.disks[i];
+    Append(i > 0 ? ",{\"name\":" : "{\"name\":");
+    AppendJsonString(disk.name);
+    Append(",\"read_bps\":");
+    AppendFloat(disk.read_rate, 0);
+    Append(",\"write_bps\":");
+    AppendFloat(disk.write_rate, 0);
+    Append(",\"iops\":");
+    AppendFloat(disk.iops, 1);
+    Append(",\"utilization\":");
+    AppendFloat(disk.utilization, 4);
+    Append("}");
+  }
+  Append("],\"interfaces\":[");
+  for (size_t i = 0; i < snapshot.interfaces.size(); ++i) {
+    const InterfaceRow& interface = snapshot.interfaces[i];
+    Append(i > 0 ? ",{\"name\":" : "{\"name\":");
+    AppendJsonString(interface.name);
+    Append(",\"rx_bps\":");
+    AppendFloat(interface.rx_rate, 0);
+    Append(",\"tx_bps\":");
+    AppendFloat(interface.tx_rate, 0);
+    Append(",\"rx_pps\":");
+    AppendFloat(interface.rx_packets, 1);
+    Append(",\"tx_pps\":");
+    AppendFloat(interface.tx_packets, 1);
+    Append(",\"drops_ps\":");
+    AppendFloat(interface.drops, 1);
+    Append(",\"errors_ps\":");
+    AppendFloat(interface.errors, 1);
+    Append("}");
+  }
+  Append("]}\n");
+}
+
+void Exporter::WriteCsv(const Snapshot& snapshot, long long timestamp_ms) {
+  if (!header_written_) {
+    Append(
+        "timestamp_ms,cpu,iowait,steal,irq,memory,total_processes,"
+        "running_processes,uptime,pid,user,process_cpu,process_memory,ram_mb,"
+        "rss_kb,pss_kb,uss_kb,swap_kb,read_bps,write_bps,process_uptime,"
+        "command\n");
+    header_written_ = true;
+  }
+  for (const ProcessRow& row : snapshot.processes) {
+    AppendInt(timestamp_ms);
+    Append(",");
+    AppendFloat(snapshot.cpu, 4);
+    Append(",");
+    AppendFloat(snapshot.iowait, 4);
+    Append(",");
+    AppendFloat(snapshot.steal, 4);
+    Append(",");
+    AppendFloat(snapshot.irq, 4);
+    Append(",");
+    AppendFloat(snapshot.memory, 4);
+    Append(",");
+    AppendInt(snapshot.total_processes);
+    Append(",");
+    AppendInt(snapshot.running_processes);
+    Append(",");
+    AppendInt(snapshot.uptime);
+    Append(",");
+    AppendInt(row.pid);
+    Append(",");
+    AppendCsvString(row.user);
+    Append(",");
+    AppendFloat(row.cpu, 4);
+    Append(",");
+    AppendFloat(row.memory, 4);
+    Append(",");
+    AppendInt(std::atol(row.ram.c_str()));
+    Append(",");
+    AppendInt(row.rss_kb);
+    // Left empty unless smaps_rollup was read
+    for (long kb : {row.pss_kb, row.uss_kb, row.swap_kb}) {
+      Append(",");
+      if (kb >= 0) AppendInt(kb);
+    }
+    for (float rate : {row.read_rate, row.write_rate}) {
+      Append(",");
+      if (rate >= 0) AppendFloat(rate, 0);
+    }
+    Append(",");
+    AppendInt(row.uptime);
+    Append(",");
+    AppendCsvString(row.command);
+    Append("\n");
+  }
+}
+
+void Exporter::Append(string_view text) { buffer_.append(text); }
+
+void Exporter::AppendInt(long long value) {
+  char digits[24];
+  int length = std::snprintf(digits, sizeof(digits), "%lld", value);
+  buffer_.append(digits, length);
+}
+
+// printf spells NaN and infinity as words, which are no JSON number; such a
+// figure is left unknown: null, or an empty CSV field
+void Exporter::AppendFloat(double value, int precision) {
+  if (!std::isfinite(value)) {
+    if (format_ == Format::kNdjson) Append("null");
+    return;
+  }
+  char digits[32];
+  int length = std::snprintf(digits, sizeof(digits), "%.*f", precision, value);
+  buffer_.append(digits, length);
+}
+
+void Exporter::AppendJsonString(string_view text) {
+  static const char kHex[] = "0123456789abcdef";
+  buffer_ += '"';
+  for (char c : text) {
+    unsigned char byte = c;
+    if (byte == '"' || byte == '\\') {
+      buffer_ += '\\';
+      buffer_ += c;
+    } else if (byte < 0x20) {
+      const char escape[] = {'\\', 'u', '0', '0', kHex[byte >> 4],
+                             kHex[byte & 0xf]};
+      buffer_.append(escape, sizeof(escape));
+    } else {
+      buffer_ += c;
+    }
+  }
+  buffer_ += '"';
+}
+
+// RFC 4180: quote every string field and double embedded quotes
+void Exporter::AppendCsvString(string_view text) {
+  buffer_ += '"';
+  for (char c : text) {
+    if (c == '"') buffer_ += '"';
+    buffer_ += c;
+  }
+  buffer_ += '"';
+}
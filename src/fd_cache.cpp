@@ -0,0 +1,128 @@
+#include "fd_cache.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+#include "instrument.h"
+#include "proc_reader.h"
+
+using std::size_t;
+using std::string_view;
+
+namespace {
+const char* const kFileNames[FdCache::kFileCount] = {"stat", "status"};
+
+// Upper bound on cached processes
+constexpr size_t kMaxProcesses = 32768;
+// Descriptors left for everything else the monitor opens
+constexpr rlim_t kReservedFds = 128;
+
+size_t DefaultCapacity() {
+  struct rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur <= kReservedFds) {
+    return 0;
+  }
+  // Use at most half of what is left, so other code never hits EMFILE
+  size_t available = (limit.rlim_cur - kReservedFds) / 2;
+  return std::min(kMaxProcesses, available / FdCache::kFileCount);
+}
+}  // namespace
+
+FdCache& FdCache::Instance() {
+  static FdCache cache(DefaultCapacity());
+  return cache;
+}
+
+FdCache::FdCache(size_t capacity) : capacity_(capacity) {}
+
+FdCache::~FdCache() {
+  for (auto& [pid, entry] : entries_) Close(entry);
+}
+
+string_view FdCache::Read(int pid, File file) {
+  Entry* entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry = Acquire(pid);
+  }
+  if (entry == nullptr) return ProcReader::ReadPid(pid, kFileNames[file]);
+
+  // The entry was touched this tick, so no other thread will evict it, and
+  // map nodes don't move when the table rehashes.
+  int& fd = entry->fds[file];
+  if (fd < 0) fd = ProcReader::OpenPid(pid, kFileNames[file]);
+  if (fd >= 0) {
+    string_view contents = ProcReader::ReadFd(fd);
+    if (!contents.empty()) return contents;
+  }
+  // ESRCH: the process this descriptor belonged to has exited. The pid may
+  // already name a new process, so fall back to a fresh open once.
+  Forget(pid);
+  return ProcReader::ReadPid(pid, kFileNames[file]);
+}
+
+// Entry for pid, created if there is room; nullptr means read uncached
+FdCache::Entry* FdCache::Acquire(int pid) {
+  auto it = entries_.find(pid);
+  if (it != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    it->second.tick = tick_;
+    return &it->second;
+  }
+  if (capacity_ == 0) return nullptr;
+  if (entries_.size() >= capacity_) {
+    // Evicting something already read this tick would only make the next
+    // lookup of it miss; serve the newcomer uncached instead.
+    int victim = lru_.back();
+    if (entries_[victim].tick == tick_) return nullptr;
+    Erase(victim);
+  }
+  lru_.push_front(pid);
+  Entry& entry = entries_[pid];
+  std::fill(std::begin(entry.fds), std::end(entry.fds), -1);
+  entry.tick = tick_;
+  entry.lru = lru_.begin();
+  return &entry;
+}
+
+// A pid that went a whole refresh without being read has left the pid list;
+// unread entries sit at the cold end of the LRU list, so trim from there.
+void FdCache::NextTick() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (!lru_.empty() && entries_[lru_.back()].tick != tick_) {
+    Erase(lru_.back());
+  }
+  ++tick_;
+}
+
+void FdCache::Forget(int pid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Erase(pid);
+}
+
+void FdCache::Erase(int pid) {
+  auto it = entries_.find(pid);
+  if (it == entries_.end()) return;
+  Close(it->second);
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void FdCache::Close(Entry& entry) {
+  for (int& fd : entry.fds) {
+    if (fd >= 0) {
+      close(fd);
+      MONITOR_COUNT(kSyscalls, 1);
+    }
+    fd = -1;
+  }
+}
+
+size_t FdCache::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t FdCache::Capacity() const { return capacity_; }
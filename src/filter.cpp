@@ -0,0 +1,377 @@
+#include "filter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include "linux_parser.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+const char kSpecial[] = "()\"!=<>~&|";
+
+bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+}  // namespace
+
+// Recursive descent over the token stream; every Parse function returns
+// the index of the node it added, or -1 once error_ is set
+class Filter::Parser {
+ public:
+  Parser(const string& text, vector<Node>& nodes)
+      : text_(text), nodes_(nodes) {}
+
+  bool Parse(string* error) {
+    Next();
+    if (token_.type != kEnd) {
+      int root = Or();
+      if (root >= 0 && token_.type != kEnd) Fail("expected && or ||");
+    }
+    if (error_.empty()) return true;
+    if (error != nullptr) {
+      *error = error_ + " at column " + std::to_string(token_.position + 1);
+    }
+    return false;
+  }
+
+  int next_bit{0};
+  bool uses_uid{false};
+
+ private:
+  enum Type { kEnd, kWord, kString, kOpen, kClose, kNot, kAnd, kOr, kOperator };
+  struct Token {
+    Type type{kEnd};
+    string text;
+    size_t position{0};
+  };
+
+  int Fail(const char* message) {
+    if (error_.empty()) error_ = message;
+    return -1;
+  }
+
+  void Next() {
+    while (position_ < text_.size() && IsSpace(text_[position_])) ++position_;
+    token_.position = position_;
+    token_.text.clear();
+    if (position_ >= text_.size()) {
+      token_.type = kEnd;
+      return;
+    }
+    char c = text_[position_];
+    char after = position_ + 1 < text_.size() ? text_[position_ + 1] : '\0';
+    auto take = [&](Type type, size_t length) {
+      token_.type = type;
+      token_.text = text_.substr(position_, length);
+      position_ += length;
+    };
+    if (c == '(') return take(kOpen, 1);
+    if (c == ')') return take(kClose, 1);
+    if (c == '&' && after == '&') return take(kAnd, 2);
+    if (c == '|' && after == '|') return take(kOr, 2);
+    if (c == '!') return take(after == '=' || after == '~' ? kOperator : kNot,
+                              after == '=' || after == '~' ? 2 : 1);
+    if (c == '<' || c == '>' || c == '=') {
+      return take(kOperator, after == '=' ? 2 : 1);
+    }
+    if (c == '~') return take(kOperator, 1);
+    if (c == '"') {
+      token_.type = kString;
+      for (++position_; position_ < text_.size(); ++position_) {
+        char d = text_[position_];
+        if (d == '"') {
+          ++position_;
+          return;
+        }
+        if (d == '\\' && position_ + 1 < text_.size()) d = text_[++position_];
+        token_.text += d;
+      }
+      Fail("unterminated string");
+      token_.type = kEnd;
+      return;
+    }
+    if (c == '&' || c == '|') {
+      Fail("expected && or ||");
+      token_.type = kEnd;
+      return;
+    }
+    size_t end = position_;
+    while (end < text_.size() && !IsSpace(text_[end]) &&
+           std::char_traits<char>::find(kSpecial, sizeof(kSpecial) - 1,
+                                        text_[end]) == nullptr) {
+      ++end;
+    }
+    take(kWord, end - position_);
+    if (token_.text == "and") token_.type = kAnd;
+    if (token_.text == "or") token_.type = kOr;
+    if (token_.text == "not") token_.type = kNot;
+  }
+
+  int Add(Node node) {
+    nodes_.push_back(std::move(node));
+    return static_cast<int>(nodes_.size()) - 1;
+  }
+
+  // One node over all the operands, cheapest first
+  int Join(Node::Kind kind, vector<int>& operands) {
+    if (operands.size() == 1) return operands[0];
+    Node node;
+    node.kind = kind;
+    for (int operand : operands) {
+      // a && (b && c) is a && b && c
+      if (nodes_[operand].kind == kind) {
+        const vector<int>& inner = nodes_[operand].children;
+        node.children.insert(node.children.end(), inner.begin(), inner.end());
+      } else {
+        node.children.push_back(operand);
+      }
+    }
+    std::stable_sort(node.children.begin(), node.children.end(),
+                     [this](int a, int b) {
+                       return nodes_[a].cost < nodes_[b].cost;
+                     });
+    for (int child : node.children) {
+      node.cost = std::max(node.cost, nodes_[child].cost);
+    }
+    return Add(std::move(node));
+  }
+
+  int Or() {
+    vector<int> operands;
+    while (true) {
+      int operand = And();
+      if (operand < 0) return -1;
+      operands.push_back(operand);
+      if (token_.type != kOr) break;
+      Next();
+    }
+    return Join(Node::kOr, operands);
+  }
+
+  int And() {
+    vector<int> operands;
+    while (true) {
+      int operand = Unary();
+      if (operand < 0) return -1;
+      operands.push_back(operand);
+      if (token_.type == kAnd) {
+        Next();
+      } else if (token_.type != kWord && token_.type != kNot &&
+                 token_.type != kOpen) {
+        break;
+      }
+    }
+    return Join(Node::kAnd, operands);
+  }
+
+  int Unary() {
+    if (token_.type == kNot) {
+      Next();
+      int operand = Unary();
+      if (operand < 0) return -1;
+      Node node;
+      node.kind = Node::kNot;
+      node.children.push_back(operand);
+      node.cost = nodes_[operand].cost;
+      return Add(std::move(node));
+    }
+    if (token_.type == kOpen) {
+      Next();
+      int inner = Or();
+      if (inner < 0) return -1;
+      if (token_.type != kClose) return Fail("expected )");
+      Next();
+      return inner;
+    }
+    return Test();
+  }
+
+  int Test() {
+    static const std::pair<const char*, Field> kFields[] = {
+        {"uid", kUid},       {"user", kUser},   {"comm", kComm},
+        {"state", kState},   {"cpu", kCpu},     {"mem", kMemory},
+        {"cmd", kCommand},   {"cgroup", kCgroup}};
+    static const std::pair<const char*, Op> kOps[] = {
+        {"==", kEqual},   {"=", kEqual},      {"!=", kNotEqual},
+        {"~", kMatch},    {"!~", kNoMatch},   {"<", kLess},
+        {"<=", kLessEqual}, {">", kGreater},  {">=", kGreaterEqual}};
+    if (token_.type != kWord) return Fail("expected a field");
+    Node node;
+    auto field = std::find_if(
+        std::begin(kFields), std::end(kFields),
+        [this](const auto& entry) { return token_.text == entry.first; });
+    if (field == std::end(kFields)) {
+      return Fail("unknown field; use uid, user, comm, state, cpu, mem, cmd "
+                  "or cgroup");
+    }
+    node.field = field->second;
+    Next();
+    if (token_.type != kOperator) return Fail("expected an operator");
+    node.op = std::find_if(std::begin(kOps), std::end(kOps),
+                           [this](const auto& entry) {
+                             return token_.text == entry.first;
+                           })->second;
+    Next();
+    if (token_.type != kWord && token_.type != kString) {
+      return Fail("expected a value");
+    }
+    node.text = token_.text;
+
+    bool numeric = node.field == kUid || node.field == kCpu ||
+                   node.field == kMemory;
+    bool ordered = node.op != kEqual && node.op != kNotEqual;
+    bool pattern = node.op == kMatch || node.op == kNoMatch;
+    if (numeric) {
+      if (pattern) return Fail("~ needs a text field");
+      char* end = nullptr;
+      node.number = std::strtod(node.text.c_str(), &end);
+      if (node.text.empty() || *end != '\0') return Fail("expected a number");
+    } else if (ordered && !pattern) {
+      return Fail("<, <=, > and >= need a numeric field");
+    } else if (node.field == kState && pattern) {
+      return Fail("state takes == or != and letters, e.g. state == DR");
+    } else if (pattern) {
+      try {
+        node.regex = std::regex(node.text, std::regex::optimize);
+      } catch (const std::regex_error&) {
+        return Fail("invalid regular expression");
+      }
+    }
+    Next();
+
+    node.cost = node.field;
+    // Which of these are remembered is up to Evaluate()
+    bool fixed = node.field != kState && node.field != kCpu &&
+                 node.field != kMemory;
+    if (fixed && next_bit < 64) node.bit = next_bit++;
+    uses_uid = uses_uid || node.field == kUid || node.field == kUser;
+    return Add(std::move(node));
+  }
+
+  const string& text_;
+  vector<Node>& nodes_;
+  size_t position_{0};
+  Token token_;
+  string error_;
+};
+
+bool Filter::Parse(const string& text, string* error) {
+  vector<Node> nodes;
+  Parser parser(text, nodes);
+  if (!parser.Parse(error)) return false;
+  text_ = text;
+  nodes_ = std::move(nodes);
+  uses_uid_ = parser.uses_uid;
+  return true;
+}
+
+Filter::Result Filter::Evaluate(const Facts& facts, Cache& cache) const {
+  Fetched fetched;
+  return Evaluate(facts, cache, fetched);
+}
+
+Filter::Result Filter::Evaluate(const Facts& facts, Cache& cache,
+                                Fetched& fetched) const {
+  if (nodes_.empty()) return Result::kTrue;
+  return Evaluate(static_cast<int>(nodes_.size()) - 1, facts, cache, fetched);
+}
+
+Filter::Result Filter::Evaluate(int index, const Facts& facts, Cache& cache,
+                                Fetched& fetched) const {
+  const Node& node = nodes_[index];
+  switch (node.kind) {
+    case Node::kTest: {
+      bool remembered = node.bit >= 0 &&
+                        (remember_identity_ || node.field == kCommand);
+      std::uint64_t mask = remembered ? std::uint64_t{1} << node.bit : 0;
+      if (cache.known & mask) {
+        return cache.value & mask ? Result::kTrue : Result::kFalse;
+      }
+      Result result = Test(node, facts, fetched);
+      if (result != Result::kUnknown) {
+        cache.known |= mask;
+        if (result == Result::kTrue) cache.value |= mask;
+      }
+      return result;
+    }
+    case Node::kNot: {
+      Result result = Evaluate(node.children[0], facts, cache, fetched);
+      if (result == Result::kUnknown) return result;
+      return result == Result::kTrue ? Result::kFalse : Result::kTrue;
+    }
+    case Node::kAnd:
+    case Node::kOr: {
+      // The operand value that settles the outcome on its own
+      Result settles = node.kind == Node::kAnd ? Result::kFalse : Result::kTrue;
+      Result outcome = node.kind == Node::kAnd ? Result::kTrue : Result::kFalse;
+      for (int child : node.children) {
+        Result result = Evaluate(child, facts, cache, fetched);
+        if (result == settles) return result;
+        if (result == Result::kUnknown) outcome = result;
+      }
+      return outcome;
+    }
+  }
+  return Result::kUnknown;
+}
+
+Filter::Result Filter::Test(const Node& node, const Facts& facts,
+                            Fetched& fetched) const {
+  auto truth = [](bool value) {
+    return value ? Result::kTrue : Result::kFalse;
+  };
+  auto number = [&](double value) {
+    switch (node.op) {
+      case kEqual: return truth(value == node.number);
+      case kNotEqual: return truth(value != node.number);
+      case kLess: return truth(value < node.number);
+      case kLessEqual: return truth(value <= node.number);
+      case kGreater: return truth(value > node.number);
+      case kGreaterEqual: return truth(value >= node.number);
+      default: return Result::kUnknown;
+    }
+  };
+  auto text = [&](const string& value) {
+    switch (node.op) {
+      case kEqual: return truth(value == node.text);
+      case kNotEqual: return truth(value != node.text);
+      case kMatch: return truth(std::regex_search(value, node.regex));
+      case kNoMatch: return truth(!std::regex_search(value, node.regex));
+      default: return Result::kUnknown;
+    }
+  };
+  switch (node.field) {
+    case kUid:
+      return facts.uid < 0 ? Result::kUnknown : number(facts.uid);
+    case kUser:
+      return facts.uid < 0 ? Result::kUnknown
+                           : text(LinuxParser::UserName(facts.uid));
+    case kComm:
+      return facts.comm == nullptr ? Result::kUnknown : text(*facts.comm);
+    case kState: {
+      if (facts.state == 0) return Result::kUnknown;
+      bool listed = node.text.find(facts.state) != string::npos;
+      return truth(node.op == kEqual ? listed : !listed);
+    }
+    case kCpu:
+      return facts.cpu < 0 ? Result::kUnknown : number(facts.cpu * 100);
+    case kMemory:
+      return facts.memory < 0 ? Result::kUnknown : number(facts.memory * 100);
+    case kCommand:
+      if (!fetched.command_read) {
+        if (!facts.fetch) return Result::kUnknown;
+        fetched.command = LinuxParser::Command(facts.pid);
+        fetched.command_read = true;
+      }
+      return text(fetched.command);
+    case kCgroup:
+      if (!fetched.cgroup_read) {
+        if (!facts.fetch) return Result::kUnknown;
+        fetched.cgroup = LinuxParser::Cgroup(facts.pid);
+        fetched.cgroup_read = true;
+      }
+      return text(fetched.cgroup);
+  }
+  return Result::kUnknown;
+}
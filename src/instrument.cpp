@@ -0,0 +1,146 @@
+#include "instrument.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+const char* const kPhaseNames[Instrument::kPhaseCount] = {
+    "refresh", "pids", "stat",         "status", "command", "user",
+    "memory",  "io",   "system files", "sort",   "sample",  "render"};
+
+#ifdef MONITOR_INSTRUMENT
+// Enough for the UI, sampler and a full worker pool; later threads share
+// the last slot, which stays correct because every update is atomic
+constexpr int kSlots = 64;
+
+struct alignas(64) Slot {
+  std::atomic<uint64_t> calls[Instrument::kPhaseCount];
+  std::atomic<uint64_t> ns[Instrument::kPhaseCount];
+  std::atomic<uint64_t> counters[Instrument::kCounterCount];
+};
+
+Slot slots[kSlots];
+std::atomic<int> slots_used{0};
+
+// Claimed without allocating, since operator new itself counts through here
+Slot& ThreadSlot() {
+  thread_local Slot* slot = nullptr;
+  if (slot == nullptr) {
+    int index = slots_used.fetch_add(1, std::memory_order_relaxed);
+    slot = &slots[index < kSlots ? index : kSlots - 1];
+  }
+  return *slot;
+}
+#endif
+}  // namespace
+
+#ifdef MONITOR_INSTRUMENT
+void Instrument::Add(Phase phase, uint64_t ns) {
+  Slot& slot = ThreadSlot();
+  slot.calls[phase].fetch_add(1, std::memory_order_relaxed);
+  slot.ns[phase].fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Instrument::Count(Counter counter, uint64_t amount) {
+  ThreadSlot().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Every allocation in the process goes through these
+void* operator new(std::size_t size) {
+  Instrument::Count(Instrument::kAllocations, 1);
+  if (size == 0) size = 1;
+  while (true) {
+    if (void* pointer = std::malloc(size)) return pointer;
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+#else
+void Instrument::Add(Phase, uint64_t) {}
+void Instrument::Count(Counter, uint64_t) {}
+#endif
+
+Instrument::Totals Instrument::Read() {
+  Totals totals;
+#ifdef MONITOR_INSTRUMENT
+  int used = std::min(slots_used.load(std::memory_order_relaxed), kSlots);
+  for (int i = 0; i < used; ++i) {
+    const Slot& slot = slots[i];
+    for (int phase = 0; phase < kPhaseCount; ++phase) {
+      totals.calls[phase] += slot.calls[phase].load(std::memory_order_relaxed);
+      totals.ns[phase] += slot.ns[phase].load(std::memory_order_relaxed);
+    }
+    for (int counter = 0; counter < kCounterCount; ++counter) {
+      totals.counters[counter] +=
+          slot.counters[counter].load(std::memory_order_relaxed);
+    }
+  }
+#endif
+  struct rusage usage {};
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    auto nanoseconds = [](const timeval& time) {
+      return static_cast<uint64_t>(time.tv_sec) * 1000000000 +
+             static_cast<uint64_t>(time.tv_usec) * 1000;
+    };
+    totals.cpu_ns = nanoseconds(usage.ru_utime) + nanoseconds(usage.ru_stime);
+    totals.max_rss_kb = usage.ru_maxrss;
+  }
+  return totals;
+}
+
+vector<string> Instrument::Report(const Totals& now, const Totals& before,
+                                  double seconds) {
+  vector<string> lines;
+  char text[128];
+  if (seconds <= 0) seconds = 1;
+  snprintf(text, sizeof(text), "monitor: %5.1f%% cpu  %ld MB peak rss",
+           (now.cpu_ns - before.cpu_ns) / (seconds * 1e7),
+           now.max_rss_kb / 1024);
+  lines.emplace_back(text);
+  if (!kEnabled) {
+    lines.emplace_back("instrumentation compiled out (MONITOR_INSTRUMENT=OFF)");
+    return lines;
+  }
+  lines.emplace_back("phase           calls/s    us/call   ms/s");
+  for (int phase = 0; phase < kPhaseCount; ++phase) {
+    uint64_t calls = now.calls[phase] - before.calls[phase];
+    double ns = now.ns[phase] - before.ns[phase];
+    snprintf(text, sizeof(text), "%-12s %10.1f %10.1f %6.1f",
+             kPhaseNames[phase], calls / seconds,
+             calls ? ns / calls / 1e3 : 0.0, ns / seconds / 1e6);
+    lines.emplace_back(text);
+  }
+  auto rate = [&](Counter counter) {
+    return (now.counters[counter] - before.counters[counter]) / seconds;
+  };
+  snprintf(text, sizeof(text),
+           "syscalls/s %.0f  read %.1f KB/s  allocations/s %.0f",
+           rate(kSyscalls), rate(kBytesRead) / 1024, rate(kAllocations));
+  lines.emplace_back(text);
+  return lines;
+}
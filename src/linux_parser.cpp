@@ -1,12 +1,21 @@
-#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <iostream>
 
+#include "fd_cache.h"
+#include "instrument.h"
 #include "linux_parser.h"
+#include "pid_scanner.h"
+#include "proc_reader.h"
+#include "user_cache.h"
 
-using std::stof;
 using std::string;
 using std::to_string;
 using std::vector;
@@ -17,149 +26,195 @@ using std::vector;
  * 
  */
 
-// DONE: An example of how to read data from the filesystem
+// Read /proc-style files from somewhere other than /proc
+bool LinuxParser::SetProcDirectory(const string& path) {
+  return ProcReader::SetRoot(path.c_str());
+}
+
+// Read the PRETTY_NAME of the distribution from os-release
 string LinuxParser::OperatingSystem() {
-  string line;
-  string key;
-  string value;
-  std::ifstream filestream(kOSPath);
-  if (filestream.is_open()) {
-    while (std::getline(filestream, line)) {
-      std::replace(line.begin(), line.end(), ' ', '_');
-      std::replace(line.begin(), line.end(), '=', ' ');
-      std::replace(line.begin(), line.end(), '"', ' ');
-      std::istringstream linestream(line);
-      while (linestream >> key >> value) {
-        if (key == "PRETTY_NAME") {
-          std::replace(value.begin(), value.end(), '_', ' ');
-          return value;
-        }
-      }
-    }
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::ReadPath(kOSPath.c_str()));
+  if (!scanner.SeekKey("PRETTY_NAME=")) return "";
+  std::string_view value = scanner.Line();
+  // The value is usually, but not necessarily, quoted
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
   }
-  return value;
+  return string(value);
 }
 
-// DONE: An example of how to read data from the filesystem
+// The kernel release is the third field of /proc/version
 string LinuxParser::Kernel() {
-  string os, version, kernel;
-  string line;
-  std::ifstream stream(kProcDirectory + kVersionFilename);
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> os >> version >> kernel;
-  }
-  return kernel;
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::Read(kVersionFilename.c_str()));
+  scanner.SkipFields(2);
+  return string(scanner.Field());
 }
 
-// BONUS: Update this to use std::filesystem
+// Every numeric directory entry of /proc is a process. Callers that scan
+// every tick should keep a PidScanner, which also reports what changed.
 vector<int> LinuxParser::Pids() {
-  vector<int> pids;
-  DIR* directory = opendir(kProcDirectory.c_str());
-  struct dirent* file;
-  while ((file = readdir(directory)) != nullptr) {
-    // Is this a directory?
-    if (file->d_type == DT_DIR) {
-      // Is every character of the name a digit?
-      string filename(file->d_name);
-      if (std::all_of(filename.begin(), filename.end(), isdigit)) {
-        int pid = stoi(filename);
-        pids.push_back(pid);
-      }
-    }
-  }
-  closedir(directory);
-  return pids;
+  PidScanner scanner;
+  scanner.Scan();
+  return scanner.Pids();
 }
 
-// Read and return the system memory utilization
-float LinuxParser::MemoryUtilization() {
-  string line;
-  string label, memUnit;
-  float memValue;
-  vector<float> allMemValues;
-  std::ifstream stream(kProcDirectory + kMeminfoFilename);
-
-  while (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> label >> memValue >> memUnit;
-
-    allMemValues.emplace_back(memValue);
-
-    // Exit when reaching third line
-    if ((label.compare("MemAvailable:") == 0)) {
+float LinuxParser::MemoryUtilization() { return Memory().utilization; }
+
+// From /proc/meminfo by key; kernels that predate MemAvailable count free
+// memory plus the page cache as available instead
+LinuxParser::MemInfo LinuxParser::Memory() {
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::Read(kMeminfoFilename.c_str()));
+  float total = 0, available = -1, free = 0, buffers = 0, cached = 0;
+  while (!scanner.AtEnd()) {
+    std::string_view key = scanner.Field();
+    if (key == "MemTotal:") {
+      total = scanner.ULong();
+    } else if (key == "MemFree:") {
+      free = scanner.ULong();
+    } else if (key == "MemAvailable:") {
+      available = scanner.ULong();
+    } else if (key == "Buffers:") {
+      buffers = scanner.ULong();
+    } else if (key == "Cached:") {
+      // The rest of the file is of no interest
+      cached = scanner.ULong();
       break;
     }
+    scanner.Line();
   }
-  stream.close();
-
-  float memAvailable = allMemValues.back();
-  allMemValues.pop_back();
-
-  //We don't need MemFree
-  allMemValues.pop_back(); 
-
-  float memTotal = allMemValues.back();
-  allMemValues.pop_back();
-
-  return ((memTotal - memAvailable) / memTotal);
+  if (available < 0) available = free + buffers + cached;
+  MemInfo memory;
+  memory.total_kb = static_cast<long>(total);
+  if (total > 0) memory.utilization = (total - available) / total;
+  return memory;
 }
 
 // Read and return the system uptime in Seconds
 long LinuxParser::UpTime() {
-  string line;
-  long uptime = 0, idleTime = 0;
-
-  std::ifstream stream(kProcDirectory + kUptimeFilename);
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> uptime >> idleTime;
-  }
-  stream.close();
-  return uptime;
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::Read(kUptimeFilename.c_str()));
+  return scanner.ULong();
 }
 
-// TODO: Read and return the total number of processes
+// Read and return the total number of processes
 int LinuxParser::TotalProcesses() {
-  string line;
-  string name;
-  int value;
-
-  std::ifstream stream(kProcDirectory + kStatFilename);
-  while (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> name >> value;
-
-    if ((name.compare("processes") == 0)) {
-      stream.close();
-      return value;
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::Read(kStatFilename.c_str()));
+  return scanner.SeekKey("processes ") ? scanner.ULong() : 0;
+}
+
+// Read and return the number of running processes
+int LinuxParser::RunningProcesses() {
+  MONITOR_SCOPE(kSystemFiles);
+  ProcReader::Scanner scanner(ProcReader::Read(kStatFilename.c_str()));
+  return scanner.SeekKey("procs_running ") ? scanner.ULong() : 0;
+}
+
+namespace {
+// Partitions follow their disk in diskstats, named after it: sda1 after sda,
+// and nvme0n1p1 after nvme0n1 since a 'p' separates digits from digits
+bool IsPartitionOf(std::string_view name, std::string_view disk) {
+  if (disk.empty() || name.size() <= disk.size() ||
+      name.compare(0, disk.size(), disk) != 0) {
+    return false;
+  }
+  std::string_view number = name.substr(disk.size());
+  if (std::isdigit(static_cast<unsigned char>(disk.back()))) {
+    if (number[0] != 'p') return false;
+    number.remove_prefix(1);
+  }
+  return !number.empty() &&
+         std::all_of(number.begin(), number.end(), [](char c) {
+           return std::isdigit(static_cast<unsigned char>(c));
+         });
+}
+}  // namespace
+
+vector<LinuxParser::DiskStat> LinuxParser::DiskStats() {
+  MONITOR_SCOPE(kSystemFiles);
+  vector<DiskStat> disks;
+  ProcReader::Scanner scanner(ProcReader::Read(kDiskstatsFilename.c_str()));
+  while (!scanner.AtEnd()) {
+    scanner.SkipFields(2);  // major, minor
+    std::string_view name = scanner.Field();
+    if (name.empty() || name.compare(0, 4, "loop") == 0 ||
+        name.compare(0, 3, "ram") == 0 ||
+        (!disks.empty() && IsPartitionOf(name, disks.back().name))) {
+      scanner.Line();
+      continue;
     }
+    DiskStat disk;
+    disk.name.assign(name);
+    disk.reads = scanner.ULong();
+    scanner.ULong();  // reads merged
+    disk.sectors_read = scanner.ULong();
+    scanner.ULong();  // ms reading
+    disk.writes = scanner.ULong();
+    scanner.ULong();  // writes merged
+    disk.sectors_written = scanner.ULong();
+    scanner.ULong();  // ms writing
+    scanner.ULong();  // in flight
+    disk.io_ms = scanner.ULong();
+    scanner.Line();
+    disks.push_back(std::move(disk));
   }
-  return 0;
+  return disks;
 }
 
-// TODO: Read and return the number of running processes
-int LinuxParser::RunningProcesses() {
-  std::string line;
-  std::string name;
-  int value;
-
-  std::ifstream stream(kProcDirectory + kStatFilename);
-  while (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> name >> value;
-
-    if ((name.compare("procs_running") == 0)) {
-      stream.close();
-      return value;
+bool LinuxParser::InterfaceSelected(std::string_view name,
+                                    const vector<string>& patterns) {
+  // Interface names are at most 15 characters; fnmatch() wants them NUL
+  // terminated
+  char terminated[64];
+  size_t length = std::min(name.size(), sizeof(terminated) - 1);
+  name.copy(terminated, length);
+  terminated[length] = '\0';
+  bool included = false, any_inclusion = false;
+  for (const string& pattern : patterns) {
+    if (!pattern.empty() && pattern[0] == '!') {
+      if (fnmatch(pattern.c_str() + 1, terminated, 0) == 0) return false;
+    } else {
+      any_inclusion = true;
+      included = included || fnmatch(pattern.c_str(), terminated, 0) == 0;
     }
   }
-  return 0;
+  return included || !any_inclusion;
+}
+
+vector<LinuxParser::NetDevStat> LinuxParser::NetDevStats(
+    const vector<string>& patterns) {
+  MONITOR_SCOPE(kSystemFiles);
+  vector<NetDevStat> interfaces;
+  ProcReader::Scanner scanner(ProcReader::Read(kNetDevFilename.c_str()));
+  scanner.Line();  // Two header lines
+  scanner.Line();
+  while (!scanner.AtEnd()) {
+    // "  eth0: 1234 ...", where large counters can close up the gap after
+    // the colon
+    std::string_view line = scanner.Line();
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) continue;
+    std::string_view name = line.substr(0, colon);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    if (!InterfaceSelected(name, patterns)) continue;
+    ProcReader::Scanner counters(line.substr(colon + 1));
+    NetDevStat interface;
+    interface.name.assign(name);
+    interface.rx_bytes = counters.ULong();
+    interface.rx_packets = counters.ULong();
+    interface.rx_errors = counters.ULong();
+    interface.rx_drops = counters.ULong();
+    counters.SkipFields(4);  // fifo, frame, compressed, multicast
+    interface.tx_bytes = counters.ULong();
+    interface.tx_packets = counters.ULong();
+    interface.tx_errors = counters.ULong();
+    interface.tx_drops = counters.ULong();
+    interfaces.push_back(std::move(interface));
+  }
+  return interfaces;
 }
 
 /**
@@ -168,48 +223,61 @@ int LinuxParser::RunningProcesses() {
  * 
  */
 
+// Read every cpu line of /proc/stat in one pass
+vector<LinuxParser::CPUStates> LinuxParser::CpuStates() {
+  MONITOR_SCOPE(kSystemFiles);
+  vector<CPUStates> states;
+  ProcReader::Scanner scanner(ProcReader::Read(kStatFilename.c_str()));
+  // The cpu lines come first; stop at the first line that isn't one.
+  while (scanner.Rest().compare(0, 3, "cpu") == 0) {
+    std::string_view cpu = scanner.Field();
+    CPUStates cpuStates{};
+    cpuStates.user = scanner.ULong();
+    cpuStates.nice = scanner.ULong();
+    cpuStates.system = scanner.ULong();
+    cpuStates.idle = scanner.ULong();
+    cpuStates.iowait = scanner.ULong();
+    cpuStates.irq = scanner.ULong();
+    cpuStates.softirq = scanner.ULong();
+    cpuStates.steal = scanner.ULong();
+    cpuStates.guest = scanner.ULong();
+    cpuStates.guestnice = scanner.ULong();
+    scanner.Line();
+    // "cpu" is the aggregate, "cpuN" is core N
+    size_t index = 0;
+    if (cpu.size() > 3) {
+      ProcReader::Scanner core(cpu.substr(3));
+      index = core.ULong() + 1;
+    }
+    if (states.size() <= index) states.resize(index + 1, CPUStates{});
+    states[index] = cpuStates;
+  }
+  return states;
+}
+
 // Read and return the number of jiffies for the system
 long LinuxParser::Jiffies() {
-  std::ifstream filestream(kProcDirectory + kStatFilename);
-  if (filestream.is_open()) {
-      std::string line;
-      //The first line has the aggregate CPU data.
-      std::getline(filestream, line);
-      std::istringstream linestream(line);
-      std::string cpu;
-      CPUStates cpuStates{};
-      linestream >> cpu >> cpuStates.user >> cpuStates.nice >> cpuStates.system >> cpuStates.idle >> cpuStates.iowait 
-                        >> cpuStates.irq >> cpuStates.softirq >> cpuStates.steal >> cpuStates.guest >> cpuStates.guestnice;
-      return cpuStates.Total();
-  }
-  return 0;
+  vector<CPUStates> states = CpuStates();
+  return states.empty() ? 0 : states[0].Total();
 }
 
 // Read and return the number of active jiffies for the system
 long LinuxParser::ActiveJiffies() {
-std::ifstream filestream(kProcDirectory + kStatFilename);
-  if (filestream.is_open()) {
-      std::string line;
-      //The first line has the aggregate CPU data.
-      std::getline(filestream, line);
-      std::istringstream linestream(line);
-      std::string cpu;
-      CPUStates cpuStates{};
-      linestream >> cpu >> cpuStates.user >> cpuStates.nice >> cpuStates.system >> cpuStates.idle >> cpuStates.iowait 
-                        >> cpuStates.irq >> cpuStates.softirq >> cpuStates.steal >> cpuStates.guest >> cpuStates.guestnice;
-      return cpuStates.Active();
-  }
-  return 0;
+  vector<CPUStates> states = CpuStates();
+  return states.empty() ? 0 : states[0].Active();
 }
 
 // TODO: Read and return the number of idle jiffies for the system
 long LinuxParser::IdleJiffies() {
-  return Jiffies() - ActiveJiffies();
+  vector<CPUStates> states = CpuStates();
+  return states.empty() ? 0 : states[0].Idle();
 }
 
-// Read and return CPU utilization
+// Read and return CPU utilization since boot
 float LinuxParser::CpuUtilization() { 
-  return (float)ActiveJiffies() / (float)Jiffies(); 
+  vector<CPUStates> states = CpuStates();
+  if (states.empty() || states[0].Total() == 0) return 0.0;
+  return (float)states[0].Active() / (float)states[0].Total(); 
 }
 
 /**
@@ -218,147 +286,249 @@ float LinuxParser::CpuUtilization() {
  * 
  */
 
-// Read and return the number of active jiffies for a PID
-long LinuxParser::ActiveJiffies(int pid) {
-  std::stringstream filename;
-  filename << kProcDirectory << "/" << pid << "/" << kStatFilename;
-  std::ifstream filestream(filename.str());
-  if (filestream.is_open()) {
-      std::string line;
-      std::getline(filestream, line);
-      std::istringstream linestream(line);
-      std::string ignore;
-      long utime, stime, cutime, cstime;
-      for(int i = 0; i < 13; i++) linestream >> ignore;
-      linestream >> utime >> stime >> cutime >> cstime ;
-      return utime + stime + cutime + cstime;
-  }
-  return 0; 
+// Read and parse every field of /proc/[pid]/stat in one pass
+LinuxParser::ProcStat LinuxParser::Stat(int pid) {
+  MONITOR_SCOPE(kStat);
+  return ParseStat(FdCache::Instance().Read(pid, FdCache::kStat));
 }
 
-// Read and return the start time (in Jiffies) for a PID
-long LinuxParser::StartTime(int pid) {
-  std::stringstream filename;
-  filename << kProcDirectory << "/" << pid << "/" << kStatFilename;
-  std::ifstream filestream(filename.str());
-  if (filestream.is_open()) {
-      std::string line;
-      std::getline(filestream, line);
-      std::istringstream linestream(line);
-      std::string ignore;
-      long starttime;
-      for(int i = 0; i < 21; i++) linestream >> ignore;
-      linestream >> starttime;
-      return starttime;
+// /proc/[pid]/task/[tid]/stat has the same layout, per thread
+LinuxParser::ProcStat LinuxParser::TaskStat(int pid, int tid) {
+  MONITOR_SCOPE(kStat);
+  char name[32] = "task/";
+  size_t length = 5 + ProcReader::FormatInt(tid, name + 5);
+  std::copy_n("/stat", 6, name + length);
+  return ParseStat(ProcReader::ReadPid(pid, name));
+}
+
+vector<int> LinuxParser::Tids(int pid) {
+  char directory[32];
+  size_t length = ProcReader::FormatInt(pid, directory);
+  std::copy_n("/task", 6, directory + length);
+  vector<int> tids;
+  ProcReader::ListPids(directory, tids);
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+LinuxParser::ProcStat LinuxParser::ParseStat(std::string_view line) {
+  ProcStat stat;
+
+  // The command name is wrapped in parentheses and may contain both spaces
+  // and ')' itself, so split on the first '(' and the last ')'.
+  size_t open = line.find('(');
+  size_t close = line.rfind(')');
+  if (open == string::npos || close == string::npos || close < open) {
+    return stat;
   }
-  return 0; 
+  stat.pid = ProcReader::Scanner(line).ULong();
+  stat.comm.assign(line.data() + open + 1, close - open - 1);
+
+  ProcReader::Scanner scanner(line.substr(close + 1));
+  std::string_view state = scanner.Field();
+  stat.state = state.empty() ? '?' : state[0];
+  stat.ppid = scanner.Long();
+  stat.pgrp = scanner.Long();
+  stat.session = scanner.Long();
+  stat.tty_nr = scanner.Long();
+  stat.tpgid = scanner.Long();
+  stat.flags = scanner.ULong();
+  stat.minflt = scanner.ULong();
+  stat.cminflt = scanner.ULong();
+  stat.majflt = scanner.ULong();
+  stat.cmajflt = scanner.ULong();
+  stat.utime = scanner.ULong();
+  stat.stime = scanner.ULong();
+  stat.cutime = scanner.Long();
+  stat.cstime = scanner.Long();
+  stat.priority = scanner.Long();
+  stat.nice = scanner.Long();
+  stat.num_threads = scanner.Long();
+  stat.itrealvalue = scanner.Long();
+  stat.starttime = scanner.ULong();
+  // Everything up to starttime is present on every kernel we care about.
+  stat.valid = !scanner.AtEnd();
+
+  // The remaining fields were added over time; older kernels stop early and
+  // leave the rest at zero.
+  stat.vsize = scanner.ULong();
+  stat.rss = scanner.Long();
+  stat.rsslim = scanner.ULong();
+  stat.startcode = scanner.ULong();
+  stat.endcode = scanner.ULong();
+  stat.startstack = scanner.ULong();
+  stat.kstkesp = scanner.ULong();
+  stat.kstkeip = scanner.ULong();
+  stat.signal = scanner.ULong();
+  stat.blocked = scanner.ULong();
+  stat.sigignore = scanner.ULong();
+  stat.sigcatch = scanner.ULong();
+  stat.wchan = scanner.ULong();
+  stat.nswap = scanner.ULong();
+  stat.cnswap = scanner.ULong();
+  stat.exit_signal = scanner.Long();
+  stat.processor = scanner.Long();
+  stat.rt_priority = scanner.ULong();
+  stat.policy = scanner.ULong();
+  stat.delayacct_blkio_ticks = scanner.ULong();
+  stat.guest_time = scanner.ULong();
+  stat.cguest_time = scanner.Long();
+  stat.start_data = scanner.ULong();
+  stat.end_data = scanner.ULong();
+  stat.start_brk = scanner.ULong();
+  stat.arg_start = scanner.ULong();
+  stat.arg_end = scanner.ULong();
+  stat.env_start = scanner.ULong();
+  stat.env_end = scanner.ULong();
+  stat.exit_code = scanner.Long();
+  return stat;
 }
 
-// Read and return the command associated with a process
+// Clock ticks (jiffies) per second, queried once
+long LinuxParser::ClockTicks() {
+  static const long ticks = sysconf(_SC_CLK_TCK);
+  return ticks;
+}
+
+// Read and return the number of active jiffies for a PID
+long LinuxParser::ActiveJiffies(int pid) { return Stat(pid).Active(); }
+
+// Read and return the start time (in Jiffies) for a PID
+long LinuxParser::StartTime(int pid) { return Stat(pid).starttime; }
+
+// Read and return the command line of a process, arguments joined by spaces
 string LinuxParser::Command(int pid) {
-  std::string command;
-  std::string line;
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kCmdlineFilename);
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    linestream >> command;
-    stream.close();
-    return command;
+  MONITOR_SCOPE(kCommand);
+  std::string_view cmdline = ProcReader::ReadPid(pid, kCmdlineFilename.c_str());
+  // Arguments are NUL-terminated; drop the final terminator(s)
+  while (!cmdline.empty() && cmdline.back() == '\0') cmdline.remove_suffix(1);
+  string command(cmdline);
+  // Separators become spaces, and so do newlines and other control bytes
+  // in the arguments, which would otherwise break up a display row
+  for (char& c : command) {
+    if (static_cast<unsigned char>(c) < ' ' || c == '\x7f') c = ' ';
   }
-  return "";
+  return command;
 }
 
-// Read and return the memory used by a process
-string LinuxParser::Ram(int pid) {
-  std::string code, vmSize, idle;
-  std::string line;
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatusFilename);
-  if (stream.is_open()) {
-    do {
-      std::getline(stream, line);
-      std::istringstream linestream(line);
-      linestream >> code >> vmSize >> idle;
-      if (stream.eof()) {
-        return "0";
-      }
-    } while (code.compare("VmSize:") != 0);
-    stream.close();
-    return (std::to_string(stoi(vmSize) / 1024));
-  }
-  return "";
+int LinuxParser::Owner(int pid) {
+  MONITOR_SCOPE(kUser);
+  char name[12];
+  ProcReader::FormatInt(pid, name);
+  struct stat info {};
+  MONITOR_COUNT(kSyscalls, 1);
+  if (fstatat(ProcReader::Root(), name, &info, 0) != 0) return -1;
+  return static_cast<int>(info.st_uid);
 }
 
-// Read and return the user ID associated with a process
-string LinuxParser::Uid(int pid) {
-  std::string label, uid;
-  std::string line;
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatusFilename);
-  if (stream.is_open()) {
-    do {
-      std::getline(stream, line);
-      std::istringstream linestream(line);
-      linestream >> label >> uid;
-    } while (label.compare("Uid:") != 0);
-    stream.close();
-    return uid;
+// Lines are hierarchy-id:controllers:path; the v2 line is "0::<path>"
+string LinuxParser::Cgroup(int pid) {
+  MONITOR_SCOPE(kCommand);
+  ProcReader::Scanner scanner(ProcReader::ReadPid(pid, kCgroupFilename.c_str()));
+  std::string_view first;
+  while (!scanner.AtEnd()) {
+    std::string_view line = scanner.Line();
+    size_t colon = line.find(':', line.find(':') + 1);
+    if (colon == std::string_view::npos) continue;
+    if (line.substr(0, 3) == "0::") return string(line.substr(colon + 1));
+    if (first.empty()) first = line.substr(colon + 1);
   }
-  return 0;
+  return string(first);
 }
 
-// Read and return the user associated with a process
-string LinuxParser::User(int pid) {
-  std::string user, userid, encPass;
-  std::string line;
-  std::ifstream stream(kPasswordPath);
-
-  string uid = LinuxParser::Uid(pid);
-
-  if (stream.is_open()) {
-    do {
-      std::getline(stream, line);
-      std::replace(line.begin(), line.end(), ':', ' ');
-      std::istringstream linestream(line);
-      linestream >> user >> encPass >> userid;
-      if (stream.eof()) return "User not found";
-    } while (userid.compare(uid) != 0);
-    stream.close();
-    return user;
+// Read the real uid from /proc/[pid]/status, stopping at its line
+LinuxParser::ProcStatus LinuxParser::Status(int pid) {
+  MONITOR_SCOPE(kStatus);
+  ProcStatus status;
+  ProcReader::Scanner scanner(FdCache::Instance().Read(pid, FdCache::kStatus));
+  if (scanner.SeekKey("Uid:")) {
+    status.uid = scanner.ULong();
+    status.valid = true;
   }
-  return "0";
+  return status;
 }
 
-// Read and return the uptime of a process
-long LinuxParser::UpTime(int pid) {
-  char state;
-  std::string comm;
-  long ppid, pgrp, session, tty_nr, tpgid, flags, minflt, cminflt, majflt,
-      cmajflt, utime, stime, cutime, cstime, priority, nice, num_threads,
-      itrealvalue;
-  std::string line;
-  long startTime = 0;
-
-  long clock = sysconf(_SC_CLK_TCK);
-
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatFilename);
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-
-    linestream >> pid >> comm >> state >> ppid >> pgrp >> session >> tty_nr >>
-        tpgid >> flags >> minflt >> cminflt >> majflt >> cmajflt >> utime >>
-        stime >> cutime >> cstime >> priority >> nice >> num_threads >>
-        itrealvalue >> startTime;
-    stream.close();
-  }
+LinuxParser::ProcStatm LinuxParser::Statm(int pid) {
+  MONITOR_SCOPE(kMemory);
+  ProcStatm statm;
+  ProcReader::Scanner scanner(ProcReader::ReadPid(pid, kStatmFilename.c_str()));
+  if (scanner.AtEnd()) return statm;
+  statm.size = scanner.ULong();
+  statm.resident = scanner.ULong();
+  statm.shared = scanner.ULong();
+  statm.text = scanner.ULong();
+  scanner.ULong();  // lib, always 0
+  statm.data = scanner.ULong();
+  statm.valid = true;
+  return statm;
+}
 
-  long uptime = (startTime / clock);
+long LinuxParser::PageSizeKb() {
+  static const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+  return page_kb;
+}
 
-  // std::cout << "Uptime: " << pid << " : " << startTime << " : " << clock << " : " << uptime << "\n";
+// The keys appear in this order, so a single forward pass reads them all
+LinuxParser::ProcMemory LinuxParser::SmapsRollup(int pid) {
+  MONITOR_SCOPE(kMemory);
+  ProcMemory memory;
+  ProcReader::Scanner scanner(
+      ProcReader::ReadPid(pid, kSmapsRollupFilename.c_str()));
+  if (!scanner.SeekKey("Rss:")) return memory;
+  memory.rss_kb = scanner.ULong();
+  if (scanner.SeekKey("Pss:")) memory.pss_kb = scanner.ULong();
+  if (scanner.SeekKey("Private_Clean:")) memory.uss_kb = scanner.ULong();
+  if (scanner.SeekKey("Private_Dirty:")) memory.uss_kb += scanner.ULong();
+  if (scanner.SeekKey("Swap:")) memory.swap_kb = scanner.ULong();
+  if (scanner.SeekKey("SwapPss:")) memory.swap_pss_kb = scanner.ULong();
+  memory.valid = true;
+  return memory;
+}
 
-  return uptime;
+LinuxParser::ProcIo LinuxParser::Io(int pid) {
+  MONITOR_SCOPE(kIo);
+  ProcIo io;
+  ProcReader::Scanner scanner(ProcReader::ReadPid(pid, kIoFilename.c_str()));
+  if (!scanner.SeekKey("rchar:")) return io;
+  io.rchar = scanner.ULong();
+  if (scanner.SeekKey("wchar:")) io.wchar = scanner.ULong();
+  if (scanner.SeekKey("read_bytes:")) io.read_bytes = scanner.ULong();
+  if (scanner.SeekKey("write_bytes:")) io.write_bytes = scanner.ULong();
+  if (scanner.SeekKey("cancelled_write_bytes:")) {
+    io.cancelled_write_bytes = scanner.ULong();
+  }
+  io.valid = true;
+  return io;
 }
 
+// Resident memory of a process in MB, from /proc/[pid]/statm
+string LinuxParser::Ram(int pid) {
+  ProcStatm statm = Statm(pid);
+  if (!statm.valid) return "";
+  return std::to_string(statm.resident * PageSizeKb() / 1024);
+}
 
+// Read and return the user ID associated with a process
+string LinuxParser::Uid(int pid) {
+  ProcStatus status = Status(pid);
+  return status.valid ? std::to_string(status.uid) : "";
+}
+
+// Resolve a uid through a cache of the password file
+string LinuxParser::UserName(int uid) {
+  MONITOR_SCOPE(kUser);
+  // Filters look users up from the worker pool
+  static std::mutex mutex;
+  static UserCache users(kPasswordPath);
+  std::lock_guard<std::mutex> lock(mutex);
+  return users.Name(uid);
+}
 
+// Read and return the user associated with a process
+string LinuxParser::User(int pid) {
+  ProcStatus status = Status(pid);
+  return status.valid ? UserName(status.uid) : "";
+}
 
+// Read and return the uptime of a process
+long LinuxParser::UpTime(int pid) { return StartTime(pid) / ClockTicks(); }
@@ -1,7 +1,430 @@
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "agent.h"
+#include "aggregator.h"
+#include "exporter.h"
+#include "filter.h"
+#include "instrument.h"
 #include "ncurses_display.h"
+#include "recording.h"
+#include "snapshot.h"
 #include "system.h"
+#include "wire.h"
+
+namespace {
+void Usage(const char* program) {
+  std::fprintf(
+      stderr,
+      "usage: %s [-j threads] [--export ndjson|csv [options]]\n"
+      "  -j, --threads N      collect process data on N threads "
+      "(default: one per core, up to 8)\n"
+      "  -e, --export FORMAT  write samples as ndjson or csv instead of "
+      "running the UI\n"
+      "  -i, --interval MS    time between exported samples (default 1000)\n"
+      "  -c, --count N        samples exported, recorded or served, 0 for no "
+      "limit\n"
+      "                       (default 0)\n"
+      "  -n, --rows N         processes per sample (default 10)\n"
+      "  -o, --output FILE    export destination (default stdout)\n"
+      "  -r, --record FILE    append samples to a ring file instead of "
+      "running the UI\n"
+      "      --record-size MB size of the ring file (default 64)\n"
+      "  -p, --replay FILE    browse a recording in the UI\n"
+      "  -S, --sort KEY       order processes by cpu, memory or io (default "
+      "cpu)\n"
+      "      --smaps          add PSS, USS and swap from smaps_rollup for each "
+      "row\n"
+      "      --tree           list processes under their parents, with totals "
+      "over\n"
+      "                       each subtree (press 'T' for it in the UI)\n"
+      "  -f, --filter EXPR    only list processes matching EXPR, e.g. 'user == "
+      "postgres'\n"
+      "                       or 'cmd ~ java && cpu > 5' (press '/' for it in "
+      "the UI)\n"
+      "      --interfaces LIST\n"
+      "                       comma-separated network interface patterns, "
+      "'!' to\n"
+      "                       exclude, e.g. 'eth*,bond*' (default '!veth*')\n"
+      "      --max-staleness N\n"
+      "                       re-read idle processes at least every N samples, "
+      "1 for\n"
+      "                       every sample (default 8)\n"
+      "      --budget N       processes re-read per sample beyond those that "
+      "must be,\n"
+      "                       0 for no limit (default 0)\n"
+      "      --agent ADDRESS  serve samples to aggregators instead of running "
+      "the UI, on a\n"
+      "                       Unix socket path or [HOST:]PORT (localhost "
+      "unless HOST\n"
+      "                       is given)\n"
+      "      --fleet LIST     show the agents at a comma-separated list of "
+      "[NAME=]ADDRESS\n"
+      "                       as one fleet, in the UI or with --export "
+      "ndjson\n"
+      "      --proc-events    follow forks and exits through the kernel proc "
+      "connector\n"
+      "                       instead of scanning /proc every refresh\n"
+      "  -s, --stats          print the monitor's own cost to stderr when an "
+      "export or\n"
+      "                       recording ends (press 'i' for it in the UI)\n",
+      program);
+}
+
+// Headless flight recorder: sample at a fixed period into the ring file
+void Record(System& system, Recording::Writer& writer, std::size_t rows,
+            std::chrono::milliseconds interval, long count) {
+  Snapshot snapshot;
+  auto deadline = std::chrono::steady_clock::now();
+  for (long sample = 0; count == 0 || sample < count; ++sample) {
+    if (sample > 0) {
+      deadline += interval;
+      std::this_thread::sleep_until(deadline);
+    }
+    system.Sample(snapshot, rows);
+    writer.Append(snapshot,
+                  std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count());
+  }
+}
+
+// Merge the fleet at a fixed period, taking frames as they arrive in
+// between; the first sample waits a period for the agents to report
+bool ExportFleet(Aggregator& aggregator, Exporter& exporter, std::size_t rows,
+                 SortKey sort, std::chrono::milliseconds interval, long count) {
+  Snapshot snapshot;
+  auto deadline = std::chrono::steady_clock::now();
+  for (long sample = 0; count == 0 || sample < count; ++sample) {
+    deadline += interval;
+    for (auto now = std::chrono::steady_clock::now(); now < deadline;
+         now = std::chrono::steady_clock::now()) {
+      aggregator.Poll(
+          std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+    }
+    aggregator.Merge(snapshot, rows, sort);
+    if (!exporter.Write(snapshot,
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// "a,b,,c" as a, b and c
+std::vector<std::string> SplitList(std::string_view list) {
+  std::vector<std::string> items;
+  while (!list.empty()) {
+    std::string_view item = list.substr(0, list.find(','));
+    if (!item.empty()) items.emplace_back(item);
+    list.remove_prefix(std::min(list.size(), item.size() + 1));
+  }
+  return items;
+}
+
+void PrintStats(const Instrument::Totals& start,
+                std::chrono::steady_clock::time_point started) {
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+  for (const std::string& line :
+       Instrument::Report(Instrument::Read(), start, seconds)) {
+    std::fprintf(stderr, "%s\n", line.c_str());
+  }
+}
+
+// Block SIGINT and SIGTERM so that one thread can wait for them. Call
+// before any other thread starts: they inherit the mask.
+sigset_t BlockStopSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  return signals;
+}
+
+// Unbounded headless runs end with a signal, so report from a thread that
+// waits for it
+void PrintStatsOnSignal(const Instrument::Totals& start,
+                        std::chrono::steady_clock::time_point started) {
+  sigset_t signals = BlockStopSignals();
+  std::thread([=] {
+    int signal = 0;
+    sigwait(&signals, &signal);
+    PrintStats(start, started);
+    _exit(128 + signal);
+  }).detach();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int threads = std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+  const char* export_format = nullptr;
+  long interval_ms = 1000;
+  long count = 0;
+  long rows = 10;
+  const char* output = nullptr;
+  const char* record = nullptr;
+  long record_mb = 64;
+  const char* replay = nullptr;
+  bool stats = false;
+  bool proc_events = false;
+  const char* sort = "cpu";
+  bool smaps = false;
+  bool tree = false;
+  const char* filter = nullptr;
+  const char* interfaces = nullptr;
+  long max_staleness = System::Options{}.max_staleness;
+  long budget = 0;
+  const char* agent = nullptr;
+  const char* fleet = nullptr;
+
+  const option options[] = {{"threads", required_argument, nullptr, 'j'},
+                            {"export", required_argument, nullptr, 'e'},
+                            {"interval", required_argument, nullptr, 'i'},
+                            {"count", required_argument, nullptr, 'c'},
+                            {"rows", required_argument, nullptr, 'n'},
+                            {"output", required_argument, nullptr, 'o'},
+                            {"record", required_argument, nullptr, 'r'},
+                            {"record-size", required_argument, nullptr, 'R'},
+                            {"replay", required_argument, nullptr, 'p'},
+                            {"proc-events", no_argument, nullptr, 'E'},
+                            {"sort", required_argument, nullptr, 'S'},
+                            {"smaps", no_argument, nullptr, 'M'},
+                            {"tree", no_argument, nullptr, 'P'},
+                            {"filter", required_argument, nullptr, 'f'},
+                            {"interfaces", required_argument, nullptr, 'I'},
+                            {"max-staleness", required_argument, nullptr, 'T'},
+                            {"budget", required_argument, nullptr, 'B'},
+                            {"agent", required_argument, nullptr, 'A'},
+                            {"fleet", required_argument, nullptr, 'F'},
+                            {"stats", no_argument, nullptr, 's'},
+                            {"help", no_argument, nullptr, 'h'},
+                            {nullptr, 0, nullptr, 0}};
+  int option;
+  while ((option = getopt_long(argc, argv, "j:e:i:c:n:o:r:p:S:f:sh", options,
+                               nullptr)) != -1) {
+    switch (option) {
+      case 'j':
+        threads = std::atoi(optarg);
+        break;
+      case 'e':
+        export_format = optarg;
+        break;
+      case 'i':
+        interval_ms = std::atol(optarg);
+        break;
+      case 'c':
+        count = std::atol(optarg);
+        break;
+      case 'n':
+        rows = std::atol(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'r':
+        record = optarg;
+        break;
+      case 'R':
+        record_mb = std::atol(optarg);
+        break;
+      case 'p':
+        replay = optarg;
+        break;
+      case 'E':
+        proc_events = true;
+        break;
+      case 'S':
+        sort = optarg;
+        break;
+      case 'M':
+        smaps = true;
+        break;
+      case 'P':
+        tree = true;
+        break;
+      case 'f':
+        filter = optarg;
+        break;
+      case 'I':
+        interfaces = optarg;
+        break;
+      case 'T':
+        max_staleness = std::atol(optarg);
+        break;
+      case 'B':
+        budget = std::atol(optarg);
+        break;
+      case 'A':
+        agent = optarg;
+        break;
+      case 'F':
+        fleet = optarg;
+        break;
+      case 's':
+        stats = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return option == 'h' ? 0 : 1;
+    }
+  }
+  if (threads < 1 || interval_ms < 1 || count < 0 || rows < 0 ||
+      max_staleness < 1 || budget < 0 ||
+      record_mb < 1 ||
+      (export_format != nullptr) + (record != nullptr) + (replay != nullptr) +
+              (agent != nullptr) > 1 ||
+      (fleet != nullptr &&
+       (record != nullptr || replay != nullptr || agent != nullptr ||
+        (export_format != nullptr && std::strcmp(export_format, "ndjson") != 0))) ||
+      (export_format != nullptr && std::strcmp(export_format, "ndjson") != 0 &&
+       std::strcmp(export_format, "csv") != 0) ||
+      (std::strcmp(sort, "cpu") != 0 && std::strcmp(sort, "memory") != 0 &&
+       std::strcmp(sort, "io") != 0)) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  std::string error;
+  if (filter != nullptr && !Filter().Parse(filter, &error)) {
+    std::fprintf(stderr, "invalid filter: %s\n", error.c_str());
+    return 1;
+  }
+
+  Wire::Endpoint endpoint;
+  if (agent != nullptr && !Wire::ParseEndpoint(agent, endpoint)) {
+    std::fprintf(stderr, "invalid address: %s\n", agent);
+    return 1;
+  }
+  SortKey sort_key = SortKey::kCpu;
+  if (std::strcmp(sort, "memory") == 0) {
+    sort_key = SortKey::kMemory;
+  } else if (std::strcmp(sort, "io") == 0) {
+    sort_key = SortKey::kIo;
+  }
+
+  if (replay != nullptr) {
+    Recording::Reader reader;
+    if (!reader.Open(replay)) {
+      std::perror(replay);
+      return 1;
+    }
+    NCursesDisplay::Replay(reader);
+    return 0;
+  }
+
+  Instrument::Totals start = Instrument::Read();
+  auto started = std::chrono::steady_clock::now();
+  stats = stats &&
+          (record != nullptr || export_format != nullptr || agent != nullptr);
+  // The agent takes the signals itself, to remove its socket on the way out
+  if (agent != nullptr) {
+    BlockStopSignals();
+  } else if (stats) {
+    PrintStatsOnSignal(start, started);
+  }
+
+  if (fleet != nullptr) {
+    Aggregator aggregator;
+    for (const std::string& target : SplitList(fleet)) {
+      if (!aggregator.Add(target)) {
+        std::fprintf(stderr, "invalid address: %s\n", target.c_str());
+        return 1;
+      }
+    }
+    if (export_format == nullptr) {
+      NCursesDisplay::Fleet(aggregator);
+      return 0;
+    }
+    std::FILE* out = output ? std::fopen(output, "w") : stdout;
+    if (out == nullptr) {
+      std::perror(output);
+      return 1;
+    }
+    std::setvbuf(out, nullptr, _IOFBF, 1 << 16);
+    Exporter exporter(out, Exporter::Format::kNdjson);
+    bool ok = ExportFleet(aggregator, exporter, rows, sort_key,
+                          std::chrono::milliseconds(interval_ms), count);
+    if (out != stdout) std::fclose(out);
+    if (stats) PrintStats(start, started);
+    return ok ? 0 : 1;
+  }
 
-int main() {
   System system;
+  system.SetThreads(threads);
+  System::Options view;
+  view.sort = sort_key;
+  view.detailed_memory = smaps;
+  view.tree = tree;
+  if (filter != nullptr) view.filter = filter;
+  view.max_staleness = max_staleness;
+  view.refresh_budget = budget;
+  if (interfaces != nullptr) view.interfaces = SplitList(interfaces);
+  system.SetOptions(view);
+  if (proc_events && !system.UseProcEvents()) {
+    std::fprintf(stderr,
+                 "proc connector unavailable (%s); scanning /proc instead\n",
+                 std::strerror(errno));
+  }
+
+  if (agent != nullptr) {
+    Agent server(system, rows, std::chrono::milliseconds(interval_ms));
+    if (!server.Listen(endpoint)) {
+      std::perror(agent);
+      return 1;
+    }
+    server.Run(count);
+    if (stats) PrintStats(start, started);
+    return 0;
+  }
+
+  if (record != nullptr) {
+    Recording::Writer writer;
+    if (!writer.Open(record, record_mb << 20)) {
+      std::perror(record);
+      return 1;
+    }
+    Record(system, writer,
+           std::min<long>(rows, Recording::kMaxProcesses),
+           std::chrono::milliseconds(interval_ms), count);
+    if (stats) PrintStats(start, started);
+    return 0;
+  }
+
+  if (export_format != nullptr) {
+    std::FILE* out = output ? std::fopen(output, "w") : stdout;
+    if (out == nullptr) {
+      std::perror(output);
+      return 1;
+    }
+    // Samples are written whole, so a large buffer means one write() each
+    std::setvbuf(out, nullptr, _IOFBF, 1 << 16);
+    Exporter exporter(out, std::strcmp(export_format, "csv") == 0
+                               ? Exporter::Format::kCsv
+                               : Exporter::Format::kNdjson);
+    bool ok = exporter.Run(system, rows, std::chrono::milliseconds(interval_ms),
+                           count);
+    if (out != stdout) std::fclose(out);
+    if (stats) PrintStats(start, started);
+    return ok ? 0 : 1;
+  }
+
   NCursesDisplay::Display(system);
-}
\ No newline at end of file
+}
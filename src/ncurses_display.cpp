@@ -1,11 +1,20 @@
 #include <curses.h>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <ctime>
 #include <string>
-#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "aggregator.h"
+#include "filter.h"
 #include "format.h"
+#include "instrument.h"
 #include "ncurses_display.h"
+#include "recording.h"
+#include "sampler.h"
+#include "snapshot.h"
 #include "system.h"
 
 using std::string;
@@ -28,82 +37,839 @@ std::string NCursesDisplay::ProgressBar(float percent) {
   return result + " " + display + "/100%";
 }
 
-void NCursesDisplay::DisplaySystem(System& system, WINDOW* window) {
+namespace {
+struct Cell {
+  std::string text;
+  int attributes{0};
+};
+
+// What was last drawn in each cell, per window, so that a frame only issues
+// output for the cells whose contents actually changed
+std::unordered_map<WINDOW*, std::unordered_map<int, Cell>> drawn;
+std::unordered_map<WINDOW*, int> layouts;
+
+// True, with the window's cell cache dropped, when its column layout differs
+// from the last frame's; the caller then clears what the cells covered
+bool ResetOnChange(WINDOW* window, int layout) {
+  auto [it, inserted] = layouts.try_emplace(window, layout);
+  if (inserted || it->second == layout) return false;
+  it->second = layout;
+  drawn.erase(window);
+  return true;
+}
+
+// Delete a window and forget what was drawn in it: a window made later can
+// be given the same address
+void DestroyWindow(WINDOW*& window) {
+  if (window == nullptr) return;
+  drawn.erase(window);
+  layouts.erase(window);
+  delwin(window);
+  window = nullptr;
+}
+
+// Host names in the fleet view are clipped to this
+constexpr int kMaxHostWidth{16};
+
+// Bytes per second in at most six characters, e.g. "512", "12.3K", "4.1G"
+const char* Throughput(float rate, char* text, std::size_t size) {
+  if (rate < 0) return "-";
+  static const char kUnits[] = " KMGT";
+  int unit = 0;
+  while (rate >= 1000 && unit < 4) {
+    rate /= 1024;
+    ++unit;
+  }
+  if (unit == 0) {
+    snprintf(text, size, "%.0f", rate);
+  } else {
+    snprintf(text, size, rate < 10 ? "%.1f%c" : "%.0f%c", rate, kUnits[unit]);
+  }
+  return text;
+}
+}  // namespace
+
+// Draw text padded or clipped to width, unless the cell already shows it
+void NCursesDisplay::PutCell(WINDOW* window, int row, int column, int width,
+                             const char* text, int attributes) {
+  Cell& previous = drawn[window][row << 16 | column];
+  if (previous.text == text && previous.attributes == attributes) return;
+  previous.text.assign(text);
+  previous.attributes = attributes;
+  width = std::min(width, getmaxx(window) - 1 - column);
+  if (width <= 0) return;
+  wattron(window, attributes);
+  mvwprintw(window, row, column, "%-*.*s", width, width, text);
+  wattroff(window, attributes);
+}
+
+// One character per core, darkest to brightest as utilization rises, so a
+// single pegged core stands out even on hosts with hundreds of them
+std::string NCursesDisplay::CoreStrip(const std::vector<float>& cores,
+                                      int first, int count) {
+  static const char kLevels[] = " .:-=+*#%@";
+  std::string strip;
+  int last = std::min(first + count, static_cast<int>(cores.size()));
+  for (int core = first; core < last; ++core) {
+    int level = static_cast<int>(cores[core] * 10);
+    strip += kLevels[std::clamp(level, 0, 9)];
+  }
+  return strip;
+}
+
+// Rows of the core strip when it starts at column 10 of a boxed window
+int NCursesDisplay::CoreRows(int cores, int width) {
+  int per_row = std::max(1, width - 12);
+  return (cores + per_row - 1) / per_row;
+}
+
+void NCursesDisplay::DisplaySystem(const Snapshot& snapshot, WINDOW* window) {
   int row{0};
-  mvwprintw(window, ++row, 2, ("OS: " + system.OperatingSystem()).c_str());
-  mvwprintw(window, ++row, 2, ("Kernel: " + system.Kernel()).c_str());
-  mvwprintw(window, ++row, 2, "CPU: ");
-  wattron(window, COLOR_PAIR(1));
-  mvwprintw(window, row, 10, "");
-  wprintw(window, ProgressBar(system.Cpu().Utilization()).c_str());
-  wattroff(window, COLOR_PAIR(1));
-  mvwprintw(window, ++row, 2, "Memory: ");
-  wattron(window, COLOR_PAIR(1));
-  mvwprintw(window, row, 10, "");
-  wprintw(window, ProgressBar(system.MemoryUtilization()).c_str());
-  wattroff(window, COLOR_PAIR(1));
-  mvwprintw(window, ++row, 2,
-            ("Total Processes: " + to_string(system.TotalProcesses())).c_str());
-  mvwprintw(
-      window, ++row, 2,
-      ("Running Processes: " + to_string(system.RunningProcesses())).c_str());
-  mvwprintw(window, ++row, 2,
-            ("Up Time: " + Format::ElapsedTime(system.UpTime())).c_str());
-  wrefresh(window);
-}
-
-void NCursesDisplay::DisplayProcesses(std::vector<Process>& processes,
-                                      WINDOW* window, int n) {
+  int width = getmaxx(window) - 2;
+  const std::vector<float>& cores = snapshot.cores;
+  int core_count = cores.size();
+  char text[256];
+  snprintf(text, sizeof(text), "OS: %s", snapshot.os.c_str());
+  PutCell(window, ++row, 2, width, text);
+  snprintf(text, sizeof(text), "Kernel: %s", snapshot.kernel.c_str());
+  PutCell(window, ++row, 2, width, text);
+  PutCell(window, ++row, 2, 8, "CPU: ");
+  PutCell(window, row, 10, width, ProgressBar(snapshot.cpu).c_str(),
+          COLOR_PAIR(1));
+  // The fleet view has a figure per host where a host has one per core
+  bool fleet = !snapshot.hosts.empty();
+  int per_row = std::max(1, width - 10);
+  PutCell(window, ++row, 2, 8, fleet ? "Hosts: " : "Cores: ");
+  for (int first = 0; first < core_count; first += per_row) {
+    if (first > 0) ++row;
+    PutCell(window, row, 10, width,
+            CoreStrip(cores, first, per_row).c_str(), COLOR_PAIR(1));
+  }
+  int hottest = 0;
+  for (int core = 1; core < core_count; ++core) {
+    if (cores[core] > cores[hottest]) hottest = core;
+  }
+  if (fleet) {
+    snprintf(text, sizeof(text),
+             "hot: %s %5.1f%%  iowait %4.1f%%  steal %4.1f%%  irq %4.1f%%",
+             snapshot.hosts[hottest].c_str(), cores[hottest] * 100,
+             snapshot.iowait * 100, snapshot.steal * 100, snapshot.irq * 100);
+  } else {
+    snprintf(text, sizeof(text),
+             "hot: cpu%-4d %5.1f%%  iowait %4.1f%%  steal %4.1f%%  irq %4.1f%%",
+             hottest, core_count ? cores[hottest] * 100 : 0.0,
+             snapshot.iowait * 100, snapshot.steal * 100, snapshot.irq * 100);
+  }
+  PutCell(window, ++row, 10, width, text);
+  PutCell(window, ++row, 2, 8, "Memory: ");
+  PutCell(window, row, 10, width, ProgressBar(snapshot.memory).c_str(),
+          COLOR_PAIR(1));
+  snprintf(text, sizeof(text), "Total Processes: %d",
+           snapshot.total_processes);
+  PutCell(window, ++row, 2, width, text);
+  snprintf(text, sizeof(text), "Running Processes: %d",
+           snapshot.running_processes);
+  PutCell(window, ++row, 2, width, text);
+  snprintf(text, sizeof(text), "Up Time: %s",
+           Format::ElapsedTime(snapshot.uptime).c_str());
+  PutCell(window, ++row, 2, width, text);
+}
+
+// Devices in kernel order, as many as fit; the rest of the panel is blank
+void NCursesDisplay::DisplayDisks(const Snapshot& snapshot, WINDOW* window) {
+  int const name_column{2};
+  int const read_column{11};
+  int const write_column{19};
+  int const iops_column{27};
+  int const busy_column{34};
+  int const header = COLOR_PAIR(2);
+  int row{0};
+  PutCell(window, ++row, name_column, 9, "DEVICE", header);
+  PutCell(window, row, read_column, 7, "READ/s", header);
+  PutCell(window, row, write_column, 7, "WRITE/s", header);
+  PutCell(window, row, iops_column, 7, "IOPS", header);
+  PutCell(window, row, busy_column, 6, "BUSY%", header);
+  char text[32];
+  int last_row = getmaxy(window) - 2;
+  for (const DiskRow& disk : snapshot.disks) {
+    if (row >= last_row) break;
+    PutCell(window, ++row, name_column, 9, disk.name.c_str());
+    PutCell(window, row, read_column, 7,
+            Throughput(disk.read_rate, text, sizeof(text)));
+    PutCell(window, row, write_column, 7,
+            Throughput(disk.write_rate, text, sizeof(text)));
+    snprintf(text, sizeof(text), "%.0f", disk.iops);
+    PutCell(window, row, iops_column, 7, text);
+    snprintf(text, sizeof(text), "%.1f", disk.utilization * 100);
+    PutCell(window, row, busy_column, 6, text);
+  }
+  while (row < last_row) {
+    PutCell(window, ++row, name_column, 9, "");
+    PutCell(window, row, read_column, 7, "");
+    PutCell(window, row, write_column, 7, "");
+    PutCell(window, row, iops_column, 7, "");
+    PutCell(window, row, busy_column, 6, "");
+  }
+}
+
+// Busiest interfaces first, as many as fit
+void NCursesDisplay::DisplayNetwork(const Snapshot& snapshot, WINDOW* window) {
+  int const name_column{2};
+  int const rx_column{15};
+  int const tx_column{23};
+  int const rx_packets_column{31};
+  int const tx_packets_column{40};
+  int const drops_column{49};
+  int const errors_column{57};
+  int const header = COLOR_PAIR(2);
   int row{0};
+  PutCell(window, ++row, name_column, 13, "INTERFACE", header);
+  PutCell(window, row, rx_column, 8, "RX/s", header);
+  PutCell(window, row, tx_column, 8, "TX/s", header);
+  PutCell(window, row, rx_packets_column, 9, "RXPKT/s", header);
+  PutCell(window, row, tx_packets_column, 9, "TXPKT/s", header);
+  PutCell(window, row, drops_column, 8, "DROP/s", header);
+  PutCell(window, row, errors_column, 8, "ERR/s", header);
+  char text[32];
+  int last_row = getmaxy(window) - 2;
+  for (const InterfaceRow& interface : snapshot.interfaces) {
+    if (row >= last_row) break;
+    PutCell(window, ++row, name_column, 13, interface.name.c_str());
+    PutCell(window, row, rx_column, 8,
+            Throughput(interface.rx_rate, text, sizeof(text)));
+    PutCell(window, row, tx_column, 8,
+            Throughput(interface.tx_rate, text, sizeof(text)));
+    snprintf(text, sizeof(text), "%.0f", interface.rx_packets);
+    PutCell(window, row, rx_packets_column, 9, text);
+    snprintf(text, sizeof(text), "%.0f", interface.tx_packets);
+    PutCell(window, row, tx_packets_column, 9, text);
+    // A trickle of drops matters, so these keep a decimal
+    snprintf(text, sizeof(text), "%.1f", interface.drops);
+    PutCell(window, row, drops_column, 8, text);
+    snprintf(text, sizeof(text), "%.1f", interface.errors);
+    PutCell(window, row, errors_column, 8, text);
+  }
+  while (row < last_row) {
+    PutCell(window, ++row, name_column, 13, "");
+    PutCell(window, row, rx_column, 8, "");
+    PutCell(window, row, tx_column, 8, "");
+    PutCell(window, row, rx_packets_column, 9, "");
+    PutCell(window, row, tx_packets_column, 9, "");
+    PutCell(window, row, drops_column, 8, "");
+    PutCell(window, row, errors_column, 8, "");
+  }
+}
+
+// Expanded processes are followed by their busiest threads, as many as fit
+// without pushing the selected process out of the window
+void NCursesDisplay::DisplayProcesses(const Snapshot& snapshot, WINDOW* window,
+                                      int n, int selected) {
+  const std::vector<ProcessRow>& processes = snapshot.processes;
+  bool detailed = snapshot.detailed_memory;
+  bool tree = snapshot.tree;
+  // Columns shift when the PSS/USS/SWAP columns come and go, and cells that
+  // straddle the old positions would not be redrawn
+  if (ResetOnChange(window, detailed)) {
+    for (int line = 1; line <= n + 1; ++line) {
+      mvwhline(window, line, 1, ' ', getmaxx(window) - 2);
+    }
+  }
+  int row{0};
+  int const last_row{n + 1};
   int const pid_column{2};
   int const user_column{9};
   int const cpu_column{16};
   int const ram_column{26};
-  int const time_column{35};
-  int const command_column{46};
-  wattron(window, COLOR_PAIR(2));
-  mvwprintw(window, ++row, pid_column, "PID");
-  mvwprintw(window, row, user_column, "USER");
-  mvwprintw(window, row, cpu_column, "CPU[%%]");
-  mvwprintw(window, row, ram_column, "RAM[MB]");
-  mvwprintw(window, row, time_column, "TIME+");
-  mvwprintw(window, row, command_column, "COMMAND");
-  wattroff(window, COLOR_PAIR(2));
-  for (int i = 0; i < n; ++i) {
-    mvwprintw(window, ++row, pid_column, to_string(processes[i].Pid()).c_str());
-    mvwprintw(window, row, user_column, processes[i].User().c_str());
-    float cpu = processes[i].CpuUtilization() * 100;
-    mvwprintw(window, row, cpu_column, to_string(cpu).substr(0, 4).c_str());
-    mvwprintw(window, row, ram_column, processes[i].Ram().c_str());
-    mvwprintw(window, row, time_column,
-              Format::ElapsedTime(processes[i].UpTime()).c_str());
-    mvwprintw(window, row, command_column,
-              processes[i].Command().substr(0, window->_maxx - 46).c_str());
+  int const pss_column{35};
+  int const uss_column{44};
+  int const swap_column{53};
+  int const read_column{detailed ? 62 : 35};
+  int const write_column{read_column + 8};
+  int const time_column{read_column + 16};
+  int const command_column{time_column + 11};
+  int const command_width = getmaxx(window) - 1 - command_column;
+  int const header = COLOR_PAIR(2);
+  auto sorted = [&](SortKey key) {
+    return snapshot.sort == key ? header | A_REVERSE : header;
+  };
+  PutCell(window, ++row, pid_column, 7, "PID", header);
+  PutCell(window, row, user_column, 7, "USER", header);
+  PutCell(window, row, cpu_column, 6, "CPU[%]", sorted(SortKey::kCpu));
+  PutCell(window, row, cpu_column + 6, 4, "", header);
+  PutCell(window, row, ram_column, 7, "RAM[MB]", sorted(SortKey::kMemory));
+  PutCell(window, row, ram_column + 7, 2, "", header);
+  if (detailed) {
+    PutCell(window, row, pss_column, 9, "PSS[MB]", header);
+    PutCell(window, row, uss_column, 9, "USS[MB]", header);
+    PutCell(window, row, swap_column, 9, "SWAP[MB]", header);
+  }
+  PutCell(window, row, read_column, 16, "READ/s  WRITE/s", sorted(SortKey::kIo));
+  PutCell(window, row, time_column, 11, "TIME+", header);
+  // Fleet rows lead with their host, in a column as wide as the longest
+  int host_width = 0;
+  for (const ProcessRow& process : processes) {
+    host_width = std::max<int>(host_width, process.host.size());
+  }
+  if (host_width > 0) host_width = std::clamp(host_width, 4, kMaxHostWidth);
+  std::string name;
+  if (host_width > 0) {
+    name.assign("HOST");
+    name.resize(host_width + 2, ' ');
+  }
+  name += tree ? "COMMAND  (figures include descendants)" : "COMMAND";
+  PutCell(window, row, command_column, command_width, name.c_str(), header);
+  char text[32];
+  auto megabytes = [&text](long kb) {
+    if (kb < 0) return "-";
+    snprintf(text, sizeof(text), "%ld", kb / 1024);
+    return static_cast<const char*>(text);
+  };
+  int count = processes.size();
+  for (int i = 0; i < count && row < last_row; ++i) {
+    const ProcessRow& process = processes[i];
+    int attributes = i == selected ? A_REVERSE : 0;
+    // Tree context for matching descendants, not a match itself
+    if (!process.matches) attributes |= A_DIM;
+    ++row;
+    snprintf(text, sizeof(text), "%d", process.pid);
+    PutCell(window, row, pid_column, 7, text, attributes);
+    PutCell(window, row, user_column, 6, process.user.c_str(), attributes);
+    snprintf(text, sizeof(text), "%.2f",
+             (tree ? process.subtree_cpu : process.cpu) * 100);
+    PutCell(window, row, cpu_column, 10, text, attributes);
+    PutCell(window, row, ram_column, 9,
+            tree ? megabytes(process.subtree_rss_kb) : process.ram.c_str(),
+            attributes);
+    if (detailed) {
+      PutCell(window, row, pss_column, 9, megabytes(process.pss_kb),
+              attributes);
+      PutCell(window, row, uss_column, 9, megabytes(process.uss_kb),
+              attributes);
+      PutCell(window, row, swap_column, 9, megabytes(process.swap_kb),
+              attributes);
+    }
+    PutCell(window, row, read_column, 8,
+            Throughput(tree ? process.subtree_read_rate : process.read_rate,
+                       text, sizeof(text)),
+            attributes);
+    PutCell(window, row, write_column, 8,
+            Throughput(tree ? process.subtree_write_rate : process.write_rate,
+                       text, sizeof(text)),
+            attributes);
+    PutCell(window, row, time_column, 11,
+            Format::ElapsedTime(process.uptime).c_str(), attributes);
+    // Indented by depth, marked when there are descendants, and led by their
+    // count when they are hidden
+    name.assign(process.command);
+    if (tree) {
+      name.assign(2 * process.depth, ' ');
+      name += process.descendants == 0 ? "  " : process.collapsed ? "+ " : "- ";
+      if (process.collapsed) {
+        snprintf(text, sizeof(text), "[%d] ", process.descendants);
+        name += text;
+      }
+      name += process.command;
+    }
+    if (host_width > 0) {
+      int host = std::min<int>(process.host.size(), host_width);
+      name.insert(0, host_width + 2 - host, ' ');
+      name.insert(0, process.host, 0, host);
+    }
+    PutCell(window, row, command_column, command_width, name.c_str(),
+            attributes);
+
+    int room = last_row - row - std::max(0, std::min(selected, count - 1) - i);
+    int shown = std::min(static_cast<int>(process.threads.size()), room);
+    for (int t = 0; t < shown; ++t) {
+      const ThreadRow& thread = process.threads[t];
+      ++row;
+      snprintf(text, sizeof(text), "%d", thread.tid);
+      PutCell(window, row, pid_column, 7, text);
+      snprintf(text, sizeof(text), "%c", thread.state);
+      PutCell(window, row, user_column, 6, text);
+      snprintf(text, sizeof(text), "%.2f", thread.cpu * 100);
+      PutCell(window, row, cpu_column, 10, text);
+      // Memory is shared by every thread; leave those columns empty
+      PutCell(window, row, ram_column, 9, "");
+      if (detailed) {
+        for (int column : {pss_column, uss_column, swap_column}) {
+          PutCell(window, row, column, 9, "");
+        }
+      }
+      PutCell(window, row, read_column, 8, "");
+      PutCell(window, row, write_column, 8, "");
+      PutCell(window, row, time_column, 11, "");
+      name.assign(t + 1 < shown ? " |- " : " `- ");
+      name += thread.name;
+      PutCell(window, row, command_column, command_width, name.c_str());
+    }
+  }
+  // Rows past the end of the list are blanked, not left stale. Every row
+  // uses the same cells, so each cell's cache stays true to the screen.
+  while (row < last_row) {
+    ++row;
+    for (int column : {pid_column, user_column, cpu_column, ram_column,
+                       pss_column, uss_column, swap_column, read_column,
+                       write_column, time_column, command_column}) {
+      // Without the detailed columns, pss_column is read_column
+      if (!detailed && (column == pss_column || column == uss_column ||
+                        column == swap_column)) {
+        continue;
+      }
+      PutCell(window, row, column, getmaxx(window) - 1 - column, "");
+    }
   }
 }
 
-void NCursesDisplay::Display(System& system, int n) {
+namespace {
+void StartCurses() {
   initscr();      // start ncurses
   noecho();       // do not print input values
   cbreak();       // terminate ncurses on ctrl + c
   start_color();  // enable color
+  keypad(stdscr, TRUE);
+  set_escdelay(25);  // Escape cancels the filter prompt without a pause
+  curs_set(0);
+  timeout(NCursesDisplay::kInputPollMs);
+  init_pair(1, COLOR_BLUE, COLOR_BLACK);
+  init_pair(2, COLOR_GREEN, COLOR_BLACK);
+  // getch() refreshes stdscr; get its first full repaint out of the way
+  // before any window is drawn over it
+  refresh();
+}
+
+struct Windows {
+  WINDOW* system{nullptr};
+  // Only when there are devices or interfaces to show, and room for them
+  WINDOW* disks{nullptr};
+  WINDOW* network{nullptr};
+  WINDOW* processes{nullptr};
+};
+
+// Room for the system window's progress bars beside the disk panel
+constexpr int kSystemMinWidth{78};
+constexpr int kDisksWidth{42};
+// Rows of a panel stacked under the system window
+constexpr int kStackedRows{4};
 
-  int x_max{getmaxx(stdscr)};
-  WINDOW* system_window = newwin(9, x_max - 1, 0, 0);
-  WINDOW* process_window =
-      newwin(3 + n, x_max - 1, system_window->_maxy + 1, 0);
-
-  while (1) {
-    init_pair(1, COLOR_BLUE, COLOR_BLACK);
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    box(system_window, 0, 0);
-    box(process_window, 0, 0);
-    DisplaySystem(system, system_window);
-    DisplayProcesses(system.Processes(), process_window, n);
-    wrefresh(system_window);
-    wrefresh(process_window);
-    refresh();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+// The system window grows with the core count, so the layout is made once
+// the first snapshot is known. The disk panel sits to the right of the
+// system window when the terminal is wide enough, and under it otherwise.
+// Panels under the system window are left out if the process table would
+// no longer fit below them.
+Windows CreateWindows(int cores, int disks, int interfaces, int n) {
+  Windows windows;
+  int width{getmaxx(stdscr) - 1};
+  int process_rows = 3 + n;
+  bool beside = disks > 0 && width >= kSystemMinWidth + kDisksWidth;
+  int system_width = beside ? width - kDisksWidth : width;
+  int system_rows = 10 + NCursesDisplay::CoreRows(cores, system_width);
+  windows.system = newwin(system_rows, system_width, 0, 0);
+  if (beside) {
+    windows.disks = newwin(system_rows, kDisksWidth, 0, system_width);
   }
+  int next_row = system_rows;
+  auto stack = [&](int count) -> WINDOW* {
+    int rows = 3 + std::min(count, kStackedRows);
+    if (count == 0 || next_row + rows + process_rows > LINES) return nullptr;
+    WINDOW* window = newwin(rows, width, next_row, 0);
+    next_row += rows;
+    return window;
+  };
+  if (!beside) windows.disks = stack(disks);
+  windows.network = stack(interfaces);
+  windows.processes = newwin(process_rows, width, next_row, 0);
+  for (WINDOW* window : {windows.system, windows.disks, windows.network,
+                         windows.processes}) {
+    if (window != nullptr) box(window, 0, 0);
+  }
+  return windows;
+}
+
+void DestroyWindows(Windows& windows) {
+  DestroyWindow(windows.system);
+  DestroyWindow(windows.disks);
+  DestroyWindow(windows.network);
+  DestroyWindow(windows.processes);
+}
+
+// The monitor's own cost, drawn over the top right corner; 'i' toggles it
+class StatsOverlay {
+ public:
+  ~StatsOverlay() { DestroyWindow(window_); }
+
+  void Toggle() {
+    shown_ = !shown_;
+    if (window_ == nullptr) Create();
+  }
+
+  // Place the panel again for a new terminal size
+  void Resize() {
+    if (window_ == nullptr) return;
+    DestroyWindow(window_);
+    Create();
+  }
+
+  bool Shown() const { return shown_; }
+
+  // Rates are refreshed once a second, averaged over the time since the
+  // last refresh; in between the panel is only layered back over windows
+  // that may have drawn across it
+  void Draw() {
+    if (!shown_) return;
+    auto now = std::chrono::steady_clock::now();
+    if (now - updated_ >= std::chrono::seconds(1)) {
+      Instrument::Totals totals = Instrument::Read();
+      double seconds = std::chrono::duration<double>(now - updated_).count();
+      lines_ = Instrument::Report(totals, before_, seconds);
+      before_ = totals;
+      updated_ = now;
+    }
+    // Only cells that changed, or are new after a resize, are drawn
+    for (size_t i = 0; i < lines_.size(); ++i) {
+      NCursesDisplay::PutCell(window_, i + 1, 1, kWidth - 2, lines_[i].c_str(),
+                              i == 1 ? COLOR_PAIR(2) : 0);
+    }
+    touchwin(window_);
+    wnoutrefresh(window_);
+  }
+
+ private:
+  static constexpr int kWidth = 54;
+
+  static std::vector<std::string> Lines() {
+    return Instrument::Report({}, {}, 1);
+  }
+
+  void Create() {
+    int height = std::min(static_cast<int>(Lines().size()) + 2, LINES);
+    int width = std::min(kWidth, COLS - 1);
+    window_ = newwin(height, width, 0, COLS - 1 - width);
+    box(window_, 0, 0);
+  }
+
+  WINDOW* window_{nullptr};
+  std::vector<std::string> lines_;  // As of the last refresh
+  bool shown_{false};
+  Instrument::Totals before_{Instrument::Read()};
+  std::chrono::steady_clock::time_point updated_{
+      std::chrono::steady_clock::now()};
+};
+
+// Text over the bottom border of the process window, redrawn on change
+void DrawFooter(WINDOW* window, int n, const std::string& text,
+                std::string& drawn) {
+  if (text == drawn) return;
+  drawn = text;
+  int width = getmaxx(window) - 4;
+  mvwhline(window, n + 2, 1, ACS_HLINE, getmaxx(window) - 2);
+  mvwprintw(window, n + 2, 2, "%.*s", width, text.c_str());
+}
+
+void Draw(const Windows& windows, const Snapshot& snapshot, int n,
+          int selected = -1) {
+  NCursesDisplay::DisplaySystem(snapshot, windows.system);
+  NCursesDisplay::DisplayProcesses(snapshot, windows.processes, n, selected);
+  wnoutrefresh(windows.system);
+  if (windows.disks != nullptr) {
+    NCursesDisplay::DisplayDisks(snapshot, windows.disks);
+    wnoutrefresh(windows.disks);
+  }
+  if (windows.network != nullptr) {
+    NCursesDisplay::DisplayNetwork(snapshot, windows.network);
+    wnoutrefresh(windows.network);
+  }
+  wnoutrefresh(windows.processes);
+}
+}  // namespace
+
+// Sampling runs on its own thread; this loop only draws the newest snapshot
+// and polls the keyboard, so a slow /proc scan never freezes the UI.
+// Up/down select a process, which stays selected as the order changes, and
+// 't' expands it into its threads. 'T' switches to the process tree, where
+// space folds the selected process's descendants away. 'P', 'M' and 'I'
+// sort by CPU, memory and I/O, and 'm' toggles the smaps_rollup columns.
+// '/' edits the filter (see Filter) on the bottom border; enter applies it
+// once it parses, an empty one lists everything, and escape cancels.
+void NCursesDisplay::Display(System& system, int n) {
+  StartCurses();
+
+  Sampler sampler(system, n, std::chrono::seconds(1));
+  System::Options options = sampler.Options();
+  sampler.Start();
+
+  Windows windows;
+  StatsOverlay overlay;
+  const Snapshot* current = nullptr;
+  int selected = 0;
+  int selected_pid = 0;
+  bool editing = false;
+  std::string query;
+  std::string problem;  // Why the query was refused
+  std::string footer;
+  for (int key = 0;; key = getch()) {
+    // Exited pids are dropped from expanded and collapsed as it samples
+    if (key != ERR) options = sampler.Options();
+    if (key == KEY_RESIZE) {
+      // Laid out afresh for the new size below
+      DestroyWindows(windows);
+      overlay.Resize();
+      footer.clear();
+      erase();
+      wnoutrefresh(stdscr);
+    }
+    if (editing && key != ERR) {
+      if (key == '\n' || key == KEY_ENTER) {
+        if (Filter().Parse(query, &problem)) {
+          editing = false;
+          options.filter = query;
+          sampler.SetOptions(options);
+        }
+      } else if (key == 27) {
+        editing = false;
+      } else if (key == KEY_BACKSPACE || key == 127 || key == '\b') {
+        if (!query.empty()) query.pop_back();
+      } else if (key >= ' ' && key < 127) {
+        query += static_cast<char>(key);
+      }
+      key = 0;  // Taken by the prompt
+    }
+    if (key == 'q') break;
+    if (key == '/') {
+      editing = true;
+      query = options.filter;
+      problem.clear();
+    }
+    const Snapshot* snapshot = sampler.Latest();
+    if (snapshot != nullptr) current = snapshot;
+    int rows = current ? current->processes.size() : 0;
+    if (snapshot != nullptr) {
+      for (int i = 0; i < rows; ++i) {
+        if (current->processes[i].pid == selected_pid) selected = i;
+      }
+    }
+    if (key == KEY_UP) --selected;
+    if (key == KEY_DOWN) ++selected;
+    selected = std::clamp(selected, 0, std::max(0, rows - 1));
+    if (rows > 0) selected_pid = current->processes[selected].pid;
+    bool changed = true;
+    std::vector<int>& expanded = options.expanded;
+    if (key == 't' && rows > 0) {
+      auto it = std::find(expanded.begin(), expanded.end(), selected_pid);
+      if (it == expanded.end()) {
+        expanded.push_back(selected_pid);
+      } else {
+        expanded.erase(it);
+      }
+    } else if (key == 'T') {
+      options.tree = !options.tree;
+    } else if (key == ' ' && options.tree && rows > 0) {
+      std::vector<int>& collapsed = options.collapsed;
+      auto it = std::find(collapsed.begin(), collapsed.end(), selected_pid);
+      if (it == collapsed.end()) {
+        collapsed.push_back(selected_pid);
+      } else {
+        collapsed.erase(it);
+      }
+    } else if (key == 'P') {
+      options.sort = SortKey::kCpu;
+    } else if (key == 'M') {
+      options.sort = SortKey::kMemory;
+    } else if (key == 'I') {
+      options.sort = SortKey::kIo;
+    } else if (key == 'm') {
+      options.detailed_memory = !options.detailed_memory;
+    } else {
+      changed = false;
+    }
+    if (changed) sampler.SetOptions(options);
+    if (key == 'i') {
+      overlay.Toggle();
+      if (!overlay.Shown()) {
+        // Uncover whatever the overlay was hiding
+        touchwin(stdscr);
+        wnoutrefresh(stdscr);
+        for (WINDOW* window : {windows.system, windows.disks, windows.network,
+                               windows.processes}) {
+          if (window == nullptr) continue;
+          touchwin(window);
+          wnoutrefresh(window);
+        }
+      }
+    }
+    if (snapshot == nullptr && !overlay.Shown() && key == ERR) continue;
+    MONITOR_SCOPE(kRender);
+    if (current != nullptr) {
+      if (windows.system == nullptr) {
+        windows = CreateWindows(current->cores.size(), current->disks.size(),
+                                current->interfaces.size(), n);
+      }
+      Draw(windows, *current, n, selected);
+      std::string text;
+      if (editing) {
+        text = " /" + query + "_  enter apply  esc cancel ";
+        if (!problem.empty()) text += " " + problem + " ";
+      } else if (!options.filter.empty()) {
+        text = " filter: " + options.filter + "   / to change ";
+      } else {
+        text = " t threads  T tree  spc fold  / filter  P/M/I sort  m pss  "
+               "i stats  q quit ";
+      }
+      DrawFooter(windows.processes, n, text, footer);
+      wnoutrefresh(windows.processes);
+    }
+    overlay.Draw();
+    doupdate();
+  }
+  sampler.Stop();
+  DestroyWindows(windows);
   endwin();
-}
\ No newline at end of file
+}
+
+// Browse a recording: arrows step one record, PgUp/PgDn jump a minute's
+// worth, Home/End go to the ends and space plays it back in real time.
+void NCursesDisplay::Replay(const Recording::Reader& recording, int n) {
+  StartCurses();
+
+  Windows windows;
+  WINDOW* status = nullptr;
+  Snapshot snapshot;
+  Recording::SnapshotRecord record;
+  long position = static_cast<long>(recording.Count()) - 1;
+  bool playing = false;
+  auto next_step = std::chrono::steady_clock::now();
+  bool dirty = true;
+  for (int key = 0; key != 'q'; key = getch()) {
+    long count = recording.Count();
+    long previous = position;
+    switch (key) {
+      case KEY_LEFT: position -= 1; break;
+      case KEY_RIGHT: position += 1; break;
+      case KEY_PPAGE: position -= 60; break;
+      case KEY_NPAGE: position += 60; break;
+      case KEY_HOME: position = 0; break;
+      case KEY_END: position = count - 1; break;
+      case ' ':
+        playing = !playing;
+        next_step = std::chrono::steady_clock::now();
+        dirty = true;
+        break;
+      case KEY_RESIZE:
+        DestroyWindows(windows);
+        DestroyWindow(status);
+        erase();
+        wnoutrefresh(stdscr);
+        dirty = true;
+        break;
+    }
+    if (playing && std::chrono::steady_clock::now() >= next_step) {
+      ++position;
+      next_step += std::chrono::seconds(1);
+      if (position >= count - 1) playing = false;
+    }
+    if (count == 0) continue;
+    position = std::clamp(position, 0L, count - 1);
+    if (position == previous && !dirty) continue;
+    // A record the recorder overwrote while it was copied is tried again
+    // on the next pass
+    dirty = !recording.Read(position, record);
+    if (dirty) continue;
+    Recording::ToSnapshot(record, snapshot);
+    if (windows.system == nullptr) {
+      windows = CreateWindows(record.core_count, 0, 0, n);
+      status = newwin(1, getmaxx(stdscr) - 1,
+                      getbegy(windows.processes) + getmaxy(windows.processes),
+                      0);
+    }
+    Draw(windows, snapshot, n);
+
+    char when[32];
+    time_t seconds = record.timestamp_ms / 1000;
+    struct tm local {};
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S",
+             localtime_r(&seconds, &local));
+    char text[160];
+    snprintf(text, sizeof(text),
+             " %s  [%ld/%ld] %s  <-/-> step  PgUp/PgDn seek  Home/End  "
+             "space play  q quit",
+             when, position + 1, count, playing ? "playing" : "paused");
+    PutCell(status, 0, 0, getmaxx(status), text, COLOR_PAIR(2));
+    wnoutrefresh(status);
+    doupdate();
+  }
+  DestroyWindows(windows);
+  DestroyWindow(status);
+  endwin();
+}
+
+// The merged view of an Aggregator's agents. The aggregator's poll is the
+// loop's wait, so frames are taken as they arrive, and the screen follows
+// at most every kInputPollMs. 'P', 'M' and 'I' rank the fleet's processes
+// by CPU, memory and I/O.
+void NCursesDisplay::Fleet(Aggregator& aggregator, int n) {
+  StartCurses();
+  timeout(0);
+
+  Windows windows;
+  Snapshot snapshot;
+  SortKey sort = SortKey::kCpu;
+  std::string footer;
+  bool dirty = true;
+  auto now = std::chrono::steady_clock::now();
+  auto next_frame = now;
+  auto measured = now;
+  std::uint64_t received = aggregator.Received();
+  double rate = 0;  // Bytes per second from every agent
+  for (int key = 0; key != 'q'; key = getch()) {
+    // Until the next frame is due, or for a key when nothing has changed
+    long wait = kInputPollMs;
+    if (dirty) {
+      wait = std::chrono::ceil<std::chrono::milliseconds>(next_frame - now)
+                 .count();
+    }
+    dirty = aggregator.Poll(std::max(0L, wait)) || dirty;
+    now = std::chrono::steady_clock::now();
+    if (key == 'P' || key == 'M' || key == 'I') {
+      sort = key == 'P' ? SortKey::kCpu
+             : key == 'M' ? SortKey::kMemory
+                          : SortKey::kIo;
+      dirty = true;
+    }
+    if (key == KEY_RESIZE) {
+      DestroyWindows(windows);
+      footer.clear();
+      erase();
+      wnoutrefresh(stdscr);
+      dirty = true;
+      next_frame = now;
+    }
+    if (now - measured >= std::chrono::seconds(1)) {
+      rate = (aggregator.Received() - received) /
+             std::chrono::duration<double>(now - measured).count();
+      received = aggregator.Received();
+      measured = now;
+      dirty = true;
+    }
+    if (!dirty || now < next_frame) continue;
+    dirty = false;
+    next_frame = now + std::chrono::milliseconds(kInputPollMs);
+
+    MONITOR_SCOPE(kRender);
+    aggregator.Merge(snapshot, n, sort);
+    if (windows.system == nullptr) {
+      // Room for every agent, whether or not it has connected yet
+      int agents = aggregator.Agents();
+      windows = CreateWindows(agents, agents, agents, n);
+    }
+    Draw(windows, snapshot, n);
+    char text[96];
+    snprintf(text, sizeof(text),
+             " %zu/%zu agents  %.1f KB/s in  P/M/I sort  q quit ",
+             aggregator.Connected(), aggregator.Agents(), rate / 1024);
+    DrawFooter(windows.processes, n, text, footer);
+    wnoutrefresh(windows.processes);
+    doupdate();
+  }
+  DestroyWindows(windows);
+  endwin();
+}
@@ -0,0 +1,55 @@
+#include "network.h"
+
+#include <algorithm>
+#include <cstddef>
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+void Network::Update(const vector<string>& patterns) {
+  vector<LinuxParser::NetDevStat> current = LinuxParser::NetDevStats(patterns);
+  auto now = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(now - time_).count();
+
+  rows_.resize(current.size());
+  for (size_t i = 0; i < current.size(); ++i) {
+    const LinuxParser::NetDevStat& interface = current[i];
+    InterfaceRow& row = rows_[i];
+    row.name = interface.name;
+    row.rx_rate = row.tx_rate = row.rx_packets = row.tx_packets = 0;
+    row.drops = row.errors = 0;
+    // Interfaces keep their order, so the previous sample is usually at i
+    const LinuxParser::NetDevStat* then = nullptr;
+    if (i < previous_.size() && previous_[i].name == interface.name) {
+      then = &previous_[i];
+    } else {
+      for (const LinuxParser::NetDevStat& candidate : previous_) {
+        if (candidate.name == interface.name) then = &candidate;
+      }
+    }
+    // Counters restart when an interface is recreated under the same name
+    if (then == nullptr || seconds <= 0 ||
+        interface.rx_bytes < then->rx_bytes ||
+        interface.tx_bytes < then->tx_bytes) {
+      continue;
+    }
+    row.rx_rate = (interface.rx_bytes - then->rx_bytes) / seconds;
+    row.tx_rate = (interface.tx_bytes - then->tx_bytes) / seconds;
+    row.rx_packets = (interface.rx_packets - then->rx_packets) / seconds;
+    row.tx_packets = (interface.tx_packets - then->tx_packets) / seconds;
+    row.drops = (interface.rx_drops - then->rx_drops + interface.tx_drops -
+                 then->tx_drops) / seconds;
+    row.errors = (interface.rx_errors - then->rx_errors +
+                  interface.tx_errors - then->tx_errors) / seconds;
+  }
+  // Ties keep kernel order, so idle interfaces don't shuffle between frames
+  std::stable_sort(rows_.begin(), rows_.end(),
+                   [](const InterfaceRow& a, const InterfaceRow& b) {
+                     return a.rx_rate + a.tx_rate > b.rx_rate + b.tx_rate;
+                   });
+  previous_ = std::move(current);
+  time_ = now;
+}
+
+const vector<InterfaceRow>& Network::Rows() const { return rows_; }
@@ -0,0 +1,118 @@
+#include "pid_scanner.h"
+
+#include <algorithm>
+
+#include "instrument.h"
+#include "proc_reader.h"
+
+using std::size_t;
+using std::vector;
+
+bool PidScanner::Scan() {
+  MONITOR_SCOPE(kPids);
+  changes_.clear();
+  changed_.clear();
+  auto now = std::chrono::steady_clock::now();
+  bool rescan = !events_.IsOpen() || now >= next_rescan_;
+  if (events_.IsOpen()) {
+    ProcEvents::Result result = events_.Drain(changes_, changed_);
+    // A broken socket means scanning from now on
+    if (result == ProcEvents::Result::kFailed) events_.Close();
+    if (result != ProcEvents::Result::kOk) rescan = true;
+  }
+
+  // The previous list becomes the buffer for this one, so neither allocates
+  // once the pid count has peaked
+  previous_.swap(pids_);
+  if (!rescan) {
+    Apply();
+  } else if (ProcReader::ListPids(".", pids_)) {
+    // /proc lists pids in ascending order; other trees may not
+    if (!std::is_sorted(pids_.begin(), pids_.end())) {
+      std::sort(pids_.begin(), pids_.end());
+    }
+    next_rescan_ = now + kRescanPeriod;
+  } else {
+    pids_.swap(previous_);
+    added_.clear();
+    removed_.clear();
+    changed_.clear();
+    return false;
+  }
+  Diff();
+
+  // Report execs only for pids that are still listed
+  std::sort(changed_.begin(), changed_.end());
+  changed_.erase(std::unique(changed_.begin(), changed_.end()), changed_.end());
+  changed_.erase(std::remove_if(changed_.begin(), changed_.end(),
+                                [&](int pid) {
+                                  return !std::binary_search(
+                                      pids_.begin(), pids_.end(), pid);
+                                }),
+                 changed_.end());
+  return true;
+}
+
+// Subscribe before the first full read, so no fork falls in between
+bool PidScanner::Subscribe() {
+  if (!events_.Open()) return false;
+  next_rescan_ = {};
+  return true;
+}
+
+bool PidScanner::Subscribed() const { return events_.IsOpen(); }
+
+// Build the new list from the previous one and this tick's forks and exits.
+// Only a pid's last event counts, and applying one that the list already
+// reflects changes nothing, so events that overlap a rescan are harmless.
+void PidScanner::Apply() {
+  std::stable_sort(changes_.begin(), changes_.end(),
+                   [](const ProcEvents::Change& a, const ProcEvents::Change& b) {
+                     return a.pid < b.pid;
+                   });
+  pids_.clear();
+  size_t old_index = 0;
+  for (size_t i = 0; i < changes_.size(); ++i) {
+    if (i + 1 < changes_.size() && changes_[i + 1].pid == changes_[i].pid) {
+      continue;
+    }
+    const ProcEvents::Change& change = changes_[i];
+    while (old_index < previous_.size() && previous_[old_index] < change.pid) {
+      pids_.push_back(previous_[old_index++]);
+    }
+    if (old_index < previous_.size() && previous_[old_index] == change.pid) {
+      ++old_index;
+    }
+    if (change.alive) pids_.push_back(change.pid);
+  }
+  pids_.insert(pids_.end(), previous_.begin() + old_index, previous_.end());
+}
+
+// One merge pass over the two sorted lists
+void PidScanner::Diff() {
+  added_.clear();
+  removed_.clear();
+  size_t old_index = 0;
+  size_t new_index = 0;
+  while (old_index < previous_.size() || new_index < pids_.size()) {
+    if (new_index == pids_.size() ||
+        (old_index < previous_.size() &&
+         previous_[old_index] < pids_[new_index])) {
+      removed_.push_back(previous_[old_index++]);
+    } else if (old_index == previous_.size() ||
+               pids_[new_index] < previous_[old_index]) {
+      added_.push_back(pids_[new_index++]);
+    } else {
+      ++old_index;
+      ++new_index;
+    }
+  }
+}
+
+const vector<int>& PidScanner::Pids() const { return pids_; }
+
+const vector<int>& PidScanner::Added() const { return added_; }
+
+const vector<int>& PidScanner::Removed() const { return removed_; }
+
+const vector<int>& PidScanner::Changed() const { return changed_; }
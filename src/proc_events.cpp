@@ -0,0 +1,167 @@
+#include "proc_events.h"
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include "instrument.h"
+
+using std::vector;
+
+namespace {
+// Room for a burst of events between two ticks; each is under 100 bytes
+constexpr int kSocketBuffer = 4 << 20;
+constexpr std::size_t kReadBuffer = 64 * 1024;
+// How long Open() waits for the kernel to confirm the subscription
+constexpr int kAckTimeoutMs = 250;
+
+const proc_event* Event(const nlmsghdr* header) {
+  auto* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+  if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) {
+    return nullptr;
+  }
+  return reinterpret_cast<const proc_event*>(message->data);
+}
+}  // namespace
+
+ProcEvents::~ProcEvents() { Close(); }
+
+bool ProcEvents::Open() {
+  Close();
+  fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+               NETLINK_CONNECTOR);
+  if (fd_ < 0) return false;
+  // Forcing past rmem_max needs CAP_NET_ADMIN, which listening needs anyway
+  if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &kSocketBuffer,
+                 sizeof(kSocketBuffer)) != 0) {
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &kSocketBuffer,
+               sizeof(kSocketBuffer));
+  }
+  sockaddr_nl address{};
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = CN_IDX_PROC;
+  address.nl_pid = 0;  // Let the kernel pick the port id
+  buffer_.resize(kReadBuffer);
+  if (bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      !Listen(true) || !AwaitAck()) {
+    int error = errno;
+    Close();
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+void ProcEvents::Close() {
+  if (fd_ < 0) return;
+  Listen(false);
+  close(fd_);
+  fd_ = -1;
+}
+
+bool ProcEvents::IsOpen() const { return fd_ >= 0; }
+
+bool ProcEvents::Listen(bool listen) {
+  proc_cn_mcast_op op = listen ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+  alignas(nlmsghdr) char request[NLMSG_SPACE(sizeof(cn_msg) + sizeof(op))]{};
+  auto* header = reinterpret_cast<nlmsghdr*>(request);
+  header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(op));
+  header->nlmsg_type = NLMSG_DONE;
+  header->nlmsg_pid = getpid();
+  auto* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+  message->id.idx = CN_IDX_PROC;
+  message->id.val = CN_VAL_PROC;
+  message->len = sizeof(op);
+  std::memcpy(message->data, &op, sizeof(op));
+  return send(fd_, request, header->nlmsg_len, 0) ==
+         static_cast<ssize_t>(header->nlmsg_len);
+}
+
+// The kernel answers a subscription with an empty event carrying its error
+// code. It sends nothing to callers outside the initial namespaces, so a
+// missing answer is a failure too.
+bool ProcEvents::AwaitAck() {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(kAckTimeoutMs);
+  while (true) {
+    int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now())
+                        .count();
+    pollfd descriptor{fd_, POLLIN, 0};
+    if (remaining <= 0 || poll(&descriptor, 1, remaining) == 0) {
+      errno = ETIMEDOUT;
+      return false;
+    }
+    ssize_t size = recv(fd_, buffer_.data(), buffer_.size(), 0);
+    if (size < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+    if (size < 0) return false;
+    for (auto* header = reinterpret_cast<nlmsghdr*>(buffer_.data());
+         NLMSG_OK(header, size); header = NLMSG_NEXT(header, size)) {
+      const proc_event* event = Event(header);
+      if (event == nullptr || event->what != proc_event::PROC_EVENT_NONE) {
+        continue;
+      }
+      errno = event->event_data.ack.err;
+      return event->event_data.ack.err == 0;
+    }
+  }
+}
+
+ProcEvents::Result ProcEvents::Drain(vector<Change>& changes,
+                                     vector<int>& execs) {
+  if (fd_ < 0) return Result::kFailed;
+  Result result = Result::kOk;
+  while (true) {
+    ssize_t size = recv(fd_, buffer_.data(), buffer_.size(), 0);
+    MONITOR_COUNT(kSyscalls, 1);
+    if (size < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return result;
+      // Events were dropped; keep draining what is left
+      if (errno == ENOBUFS) {
+        result = Result::kOverflow;
+        continue;
+      }
+      return Result::kFailed;
+    }
+    for (auto* header = reinterpret_cast<nlmsghdr*>(buffer_.data());
+         NLMSG_OK(header, size); header = NLMSG_NEXT(header, size)) {
+      if (header->nlmsg_type == NLMSG_OVERRUN) result = Result::kOverflow;
+      if (header->nlmsg_type != NLMSG_DONE) continue;
+      const proc_event* event = Event(header);
+      if (event == nullptr) continue;
+      const auto& data = event->event_data;
+      switch (event->what) {
+        // New threads and exiting threads other than the leader leave the
+        // process list unchanged
+        case proc_event::PROC_EVENT_FORK:
+          if (data.fork.child_pid == data.fork.child_tgid) {
+            changes.push_back({data.fork.child_tgid, true});
+          }
+          break;
+        case proc_event::PROC_EVENT_EXIT:
+          if (data.exit.process_pid == data.exit.process_tgid) {
+            changes.push_back({data.exit.process_tgid, false});
+          }
+          break;
+        case proc_event::PROC_EVENT_EXEC:
+          execs.push_back(data.exec.process_tgid);
+          break;
+        case proc_event::PROC_EVENT_UID:
+          execs.push_back(data.id.process_tgid);
+          break;
+        case proc_event::PROC_EVENT_COMM:
+          execs.push_back(data.comm.process_tgid);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
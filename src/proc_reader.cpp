@@ -0,0 +1,233 @@
+#include "proc_reader.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include "instrument.h"
+
+using std::size_t;
+using std::string_view;
+
+namespace {
+// Large enough for /proc/stat on a many-core host in one read()
+constexpr size_t kInitialBufferSize = 64 * 1024;
+
+std::vector<char>& Buffer() {
+  thread_local std::vector<char> buffer(kInitialBufferSize);
+  return buffer;
+}
+
+// Slurp a file into the thread's buffer, growing it only when it fills up
+string_view Slurp(int fd, bool positioned) {
+  std::vector<char>& buffer = Buffer();
+  size_t size = 0;
+  while (true) {
+    if (size == buffer.size()) buffer.resize(buffer.size() * 2);
+    char* end = buffer.data() + size;
+    size_t room = buffer.size() - size;
+    ssize_t count =
+        positioned ? pread(fd, end, room, size) : read(fd, end, room);
+    MONITOR_COUNT(kSyscalls, 1);
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0) return {};
+    if (count == 0) break;
+    size += count;
+  }
+  MONITOR_COUNT(kBytesRead, size);
+  return string_view(buffer.data(), size);
+}
+
+string_view ReadAt(int dirfd, const char* path) {
+  int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+  MONITOR_COUNT(kSyscalls, 1);
+  if (fd < 0) return {};
+  string_view contents = Slurp(fd, false);
+  close(fd);
+  MONITOR_COUNT(kSyscalls, 1);
+  return contents;
+}
+
+// "<pid>/<name>" relative to the /proc root
+void PidPath(int pid, const char* name, char* path, size_t capacity) {
+  size_t length = ProcReader::FormatInt(pid, path);
+  path[length++] = '/';
+  while (*name == '/') ++name;
+  for (const char* c = name; *c && length < capacity - 1; ++c) {
+    path[length++] = *c;
+  }
+  path[length] = '\0';
+}
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\0';
+}
+}  // namespace
+
+namespace {
+// Room for several thousand entries per getdents64() call
+constexpr size_t kDirectoryBufferSize = 128 * 1024;
+
+// The kernel's struct linux_dirent64; glibc doesn't export it
+struct LinuxDirent64 {
+  std::uint64_t d_ino;
+  std::int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+int OpenRoot(const char* path) {
+  return open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+std::atomic<int> root{OpenRoot("/proc")};
+}  // namespace
+
+int ProcReader::Root() { return root.load(std::memory_order_relaxed); }
+
+bool ProcReader::SetRoot(const char* path) {
+  int fd = OpenRoot(path);
+  if (fd < 0) return false;
+  int previous = root.exchange(fd);
+  if (previous >= 0) close(previous);
+  return true;
+}
+
+bool ProcReader::ListPids(const char* directory, std::vector<int>& pids) {
+  thread_local std::vector<char> buffer(kDirectoryBufferSize);
+  pids.clear();
+  int fd = openat(Root(), directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  MONITOR_COUNT(kSyscalls, 1);
+  if (fd < 0) return false;
+  bool ok = true;
+  while (true) {
+    long count = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+    MONITOR_COUNT(kSyscalls, 1);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) {
+      ok = count == 0;
+      break;
+    }
+    // Parse the names in place; anything that isn't all digits is skipped
+    for (long offset = 0; offset < count;) {
+      auto* entry = reinterpret_cast<LinuxDirent64*>(buffer.data() + offset);
+      offset += entry->d_reclen;
+      if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+      int pid = 0;
+      const char* c = entry->d_name;
+      for (; *c >= '0' && *c <= '9'; ++c) pid = pid * 10 + (*c - '0');
+      if (*c == '\0' && c != entry->d_name) pids.push_back(pid);
+    }
+  }
+  close(fd);
+  MONITOR_COUNT(kSyscalls, 1);
+  return ok;
+}
+
+string_view ProcReader::Read(const char* name) {
+  while (*name == '/') ++name;
+  return ReadAt(Root(), name);
+}
+
+string_view ProcReader::ReadPid(int pid, const char* name) {
+  char path[64];
+  PidPath(pid, name, path, sizeof(path));
+  return ReadAt(Root(), path);
+}
+
+int ProcReader::OpenPid(int pid, const char* name) {
+  char path[64];
+  PidPath(pid, name, path, sizeof(path));
+  MONITOR_COUNT(kSyscalls, 1);
+  return openat(Root(), path, O_RDONLY | O_CLOEXEC);
+}
+
+string_view ProcReader::ReadPath(const char* path) {
+  return ReadAt(AT_FDCWD, path);
+}
+
+string_view ProcReader::ReadFd(int fd) { return Slurp(fd, true); }
+
+size_t ProcReader::FormatInt(int value, char* out) {
+  char digits[12];
+  size_t count = 0;
+  unsigned int magnitude = value < 0 ? 0u - value : value;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  size_t length = 0;
+  if (value < 0) out[length++] = '-';
+  while (count > 0) out[length++] = digits[--count];
+  out[length] = '\0';
+  return length;
+}
+
+void ProcReader::Scanner::SkipSpaces() {
+  while (pos_ < text_.size() && IsSpace(text_[pos_])) ++pos_;
+}
+
+string_view ProcReader::Scanner::Field() {
+  SkipSpaces();
+  size_t start = pos_;
+  while (pos_ < text_.size() && !IsSpace(text_[pos_])) ++pos_;
+  return text_.substr(start, pos_ - start);
+}
+
+void ProcReader::Scanner::SkipFields(int count) {
+  for (int i = 0; i < count; ++i) Field();
+}
+
+long long ProcReader::Scanner::Long() {
+  SkipSpaces();
+  bool negative = pos_ < text_.size() && text_[pos_] == '-';
+  if (negative) ++pos_;
+  long long value = static_cast<long long>(ULong());
+  return negative ? -value : value;
+}
+
+unsigned long long ProcReader::Scanner::ULong() {
+  SkipSpaces();
+  unsigned long long value = 0;
+  while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') {
+    value = value * 10 + (text_[pos_++] - '0');
+  }
+  return value;
+}
+
+double ProcReader::Scanner::Double() {
+  double value = static_cast<double>(ULong());
+  if (pos_ < text_.size() && text_[pos_] == '.') {
+    double scale = 0.1;
+    for (++pos_; pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9';
+         ++pos_, scale /= 10) {
+      value += (text_[pos_] - '0') * scale;
+    }
+  }
+  return value;
+}
+
+string_view ProcReader::Scanner::Line() {
+  size_t start = pos_;
+  while (pos_ < text_.size() && text_[pos_] != '\n') ++pos_;
+  string_view line = text_.substr(start, pos_ - start);
+  if (pos_ < text_.size()) ++pos_;
+  return line;
+}
+
+bool ProcReader::Scanner::SeekKey(string_view key) {
+  while (!AtEnd()) {
+    if (text_.compare(pos_, key.size(), key) == 0) {
+      pos_ += key.size();
+      return true;
+    }
+    Line();
+  }
+  return false;
+}
@@ -19,27 +19,48 @@ void Process::setPid(int pid) {
     this->pid_ = pid;
 }
 
-// Return this process's CPU utilization
-float Process::CpuUtilization() const { 
-    float activeJiffies = LinuxParser::ActiveJiffies(Pid());  // In jiffies
-    float systemUptime = LinuxParser::UpTime();  // In seconds
-    float processStartTime = LinuxParser::StartTime(Pid()); // In jiffies
+void Process::Refresh(long system_uptime) {
+    this->system_uptime_ = system_uptime;
+    this->stat_ = LinuxParser::Stat(Pid());
+    this->status_loaded_ = false;
+    this->cpu_ = ComputeCpuUtilization();
+    this->io_ = LinuxParser::ProcIo{};
+}
+
+const LinuxParser::ProcStat& Process::Stat() const { return this->stat_; }
+
+const LinuxParser::ProcStatus& Process::Status() {
+    if (!status_loaded_) {
+        this->status_ = LinuxParser::Status(Pid());
+        this->status_loaded_ = true;
+    }
+    return this->status_;
+}
+
+void Process::RefreshIo() { this->io_ = LinuxParser::Io(Pid()); }
 
-    long jiffiesPerSec = sysconf(_SC_CLK_TCK);
+const LinuxParser::ProcIo& Process::Io() const { return this->io_; }
 
-    float processActiveTime = activeJiffies / jiffiesPerSec;
+// Return this process's CPU utilization, as of the last Refresh()
+float Process::CpuUtilization() const { return this->cpu_; }
 
-    float processStartTimeInSec = processStartTime / jiffiesPerSec;
+void Process::setCpuUtilization(float utilization) {
+    this->cpu_ = utilization;
+}
+
+float Process::ComputeCpuUtilization() const {
+    if (!stat_.valid) return 0.0;
+
+    float jiffiesPerSec = LinuxParser::ClockTicks();
 
-    float timeSinceProcessStart = systemUptime - processStartTimeInSec;
+    float processActiveTime = stat_.Own() / jiffiesPerSec;
 
-    float cpuUsage = processActiveTime / timeSinceProcessStart;
+    float processStartTimeInSec = stat_.starttime / jiffiesPerSec;
 
-    // std::cout << "Process: " << Pid() << " : " << activeJiffies << " : " << jiffiesPerSec << " : " 
-    //           << processActiveTime << " : " << processStartTimeInSec << " : " << systemUptime << " : "
-    //           << timeSinceProcessStart << " : " << cpuUsage << "\n";
+    float timeSinceProcessStart = system_uptime_ - processStartTimeInSec;
+    if (timeSinceProcessStart <= 0) return 0.0;
 
-    return cpuUsage;
+    return processActiveTime / timeSinceProcessStart;
 }
 
 // Return the command that generated this process
@@ -48,22 +69,27 @@ string Process::Command() {
     return LinuxParser::Command(Pid());
 }
 
-// Return this process's memory utilization
+// Return this process's resident memory in MB. The rss field of stat is
+// what statm reports as resident, and it is already parsed every refresh.
 string Process::Ram() { 
-    //Get the memory Utilization for the current process.
-    return LinuxParser::Ram(Pid());
+    return to_string(RssKb() / 1024);
+}
+
+long Process::RssKb() const {
+    return stat_.rss * LinuxParser::PageSizeKb();
 }
 
 // Return the user (name) that generated this process
 string Process::User() { 
     //Get the creator user name for the current process.
-    return LinuxParser::User(Pid());
+    const LinuxParser::ProcStatus& status = Status();
+    return status.valid ? LinuxParser::UserName(status.uid) : "";
 }
 
 // Return the age of this process (in seconds)
 long int Process::UpTime() const { 
     //Get the uptime for the current process.
-    return LinuxParser::UpTime(Pid());
+    return stat_.starttime / LinuxParser::ClockTicks();
 }
 
 // Overload the "less than" comparison operator for Process objects
@@ -0,0 +1,95 @@
+#include "process_history.h"
+
+#include "linux_parser.h"
+
+using std::size_t;
+
+namespace {
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 16;
+  while (power < n) power <<= 1;
+  return power;
+}
+
+// Fibonacci hashing spreads the sequential pids the kernel hands out
+size_t Hash(int pid) { return static_cast<size_t>(pid) * 0x9E3779B97F4A7C15ull; }
+}  // namespace
+
+ProcessHistory::ProcessHistory(size_t capacity)
+    : slots_(RoundUpToPowerOfTwo(capacity), Slot{}),
+      mask_(slots_.size() - 1) {}
+
+// Index of the slot holding pid, or of the empty slot where it belongs
+size_t ProcessHistory::Find(int pid) const {
+  size_t index = (Hash(pid) >> 32) & mask_;
+  while (slots_[index].pid != 0 && slots_[index].pid != pid) {
+    index = (index + 1) & mask_;
+  }
+  return index;
+}
+
+bool ProcessHistory::Update(int pid, unsigned long long starttime,
+                            long active_jiffies, double now,
+                            float* utilization) {
+  // Keep the load factor under 1/2 so probe sequences stay short
+  if ((size_ + 1) * 2 > slots_.size()) Grow();
+
+  Slot& slot = slots_[Find(pid)];
+  bool known = slot.pid == pid && slot.starttime == starttime;
+  if (known) {
+    double elapsed = now - slot.time;
+    long jiffies = active_jiffies - slot.active_jiffies;
+    if (elapsed > 0 && jiffies >= 0) {
+      *utilization = jiffies / (elapsed * LinuxParser::ClockTicks());
+    } else {
+      known = false;
+    }
+  }
+  if (slot.pid == 0) ++size_;
+
+  slot.pid = pid;
+  slot.starttime = starttime;
+  slot.active_jiffies = active_jiffies;
+  slot.time = now;
+  return known;
+}
+
+bool ProcessHistory::Contains(int pid, unsigned long long starttime) const {
+  const Slot& slot = slots_[Find(pid)];
+  return slot.pid == pid && slot.starttime == starttime;
+}
+
+void ProcessHistory::Forget(int pid) {
+  size_t index = Find(pid);
+  if (slots_[index].pid == pid) Erase(index);
+}
+
+size_t ProcessHistory::Size() const { return size_; }
+
+// Backward-shift deletion: pull later members of the probe run into the hole
+// so lookups never need tombstones.
+void ProcessHistory::Erase(size_t index) {
+  size_t hole = index;
+  size_t next = (hole + 1) & mask_;
+  while (slots_[next].pid != 0) {
+    size_t home = (Hash(slots_[next].pid) >> 32) & mask_;
+    // Move the entry only if its home is not cyclically within (hole, next]
+    if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+      slots_[hole] = slots_[next];
+      hole = next;
+    }
+    next = (next + 1) & mask_;
+  }
+  slots_[hole] = Slot{};
+  --size_;
+}
+
+void ProcessHistory::Grow() {
+  std::vector<Slot> old;
+  old.swap(slots_);
+  slots_.assign(old.size() * 2, Slot{});
+  mask_ = slots_.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.pid != 0) slots_[Find(slot.pid)] = slot;
+  }
+}
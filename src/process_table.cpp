@@ -0,0 +1,271 @@
+#include "process_table.h"
+
+#include <algorithm>
+
+using std::size_t;
+
+void ProcessTable::Totals::Add(const Totals& other, double scale) {
+  cpu += scale * other.cpu;
+  rss += scale * other.rss;
+  read_rate += scale * other.read_rate;
+  write_rate += scale * other.write_rate;
+  processes += scale * other.processes;
+}
+
+template <typename Function>
+void ProcessTable::ForEachColumn(Function function) {
+  function(pid);
+  function(valid);
+  function(starttime);
+  function(active);
+  function(active_before);
+  function(time);
+  function(time_before);
+  function(rss);
+  function(lifetime);
+  function(cpu);
+  function(memory);
+  function(key);
+  function(io_read);
+  function(io_write);
+  function(io_time);
+  function(io_tick);
+  function(read_rate);
+  function(write_rate);
+  function(read);
+  function(due);
+  function(interval);
+  function(uid);
+  function(filter);
+  function(excluded);
+  function(shown);
+  function(ppid);
+  function(parent);
+  function(first_child);
+  function(next_sibling);
+  function(previous_sibling);
+  function(own);
+  function(subtree);
+  function(process);
+}
+
+size_t ProcessTable::Find(int pid) const {
+  auto it = rows_.find(pid);
+  return it == rows_.end() ? npos : it->second;
+}
+
+size_t ProcessTable::Add(int pid) {
+  size_t row = Size();
+  ForEachColumn([](auto& column) { column.emplace_back(); });
+  this->pid[row] = pid;
+  read_rate[row] = write_rate[row] = -1;
+  interval[row] = 1;
+  uid[row] = -1;
+  shown[row] = 1;
+  process[row].setPid(pid);
+  rows_[pid] = row;
+  return row;
+}
+
+void ProcessTable::Remove(int pid) {
+  auto it = rows_.find(pid);
+  if (it == rows_.end()) return;
+  size_t row = it->second;
+  if (tree_) {
+    AddToAncestors(row, subtree[row], -1);
+    Unlink(row);
+    // The kernel hands orphans to a reaper; they stand alone until their
+    // next read finds the new parent, which is made at once
+    for (int child = first_child[row]; child != 0;) {
+      size_t child_row = Find(child);
+      child = next_sibling[child_row];
+      parent[child_row] = next_sibling[child_row] = 0;
+      previous_sibling[child_row] = 0;
+      due[child_row] = 0;
+    }
+  }
+  size_t last = Size() - 1;
+  rows_.erase(it);
+  if (row != last) rows_[this->pid[last]] = row;
+  ForEachColumn([row, last](auto& column) {
+    if (row != last) column[row] = std::move(column[last]);
+    column.pop_back();
+  });
+}
+
+void ProcessTable::Clear() {
+  ForEachColumn([](auto& column) { column.clear(); });
+  rows_.clear();
+}
+
+void ProcessTable::Record(size_t row, double now) {
+  const LinuxParser::ProcStat& stat = process[row].Stat();
+  valid[row] = stat.valid;
+  if (!stat.valid) return;
+  // A pid reused between scans starts over
+  if (stat.starttime != starttime[row]) {
+    starttime[row] = stat.starttime;
+    time[row] = 0;
+    io_tick[row] = 0;
+  }
+  active_before[row] = active[row];
+  time_before[row] = time[row];
+  active[row] = stat.Own();
+  time[row] = now;
+  rss[row] = stat.rss;
+  ppid[row] = stat.ppid;
+  lifetime[row] = process[row].CpuUtilization();
+}
+
+void ProcessTable::RecordIo(size_t row, double now, unsigned long tick,
+                            unsigned long max_gap) {
+  const LinuxParser::ProcIo& io = process[row].Io();
+  read_rate[row] = write_rate[row] = -1;
+  if (!io.valid) {
+    io_tick[row] = 0;
+    return;
+  }
+  double seconds = now - io_time[row];
+  if (io_tick[row] != 0 && tick - io_tick[row] <= max_gap && seconds > 0 &&
+      io.read_bytes >= io_read[row] && io.write_bytes >= io_write[row]) {
+    read_rate[row] = (io.read_bytes - io_read[row]) / seconds;
+    write_rate[row] = (io.write_bytes - io_write[row]) / seconds;
+  }
+  io_read[row] = io.read_bytes;
+  io_write[row] = io.write_bytes;
+  io_time[row] = now;
+  io_tick[row] = tick;
+}
+
+// Branch-free over whole columns: the interval figure is computed for every
+// row and the lifetime average selected where there is no baseline yet. The
+// file is built with -fno-trapping-math, without which GCC won't turn the
+// select into a blend, since the comparisons could raise FP exceptions.
+void ProcessTable::ComputeUtilization(float clock_ticks, float memory_pages) {
+  size_t rows = Size();
+  double page_share = memory_pages > 0 ? 1.0 / memory_pages : 0;
+  for (size_t i = 0; i < rows; ++i) {
+    double elapsed = time[i] - time_before[i];
+    double jiffies = active[i] - active_before[i];
+    double interval = jiffies / (elapsed * clock_ticks);
+    // Loaded unconditionally so the select has nothing left to guard
+    float since_start = lifetime[i];
+    // & rather than &&, which would put a branch in the loop
+    bool known = (time_before[i] > 0) & (elapsed > 0) & (jiffies >= 0);
+    cpu[i] = known ? static_cast<float>(interval) : since_start;
+    memory[i] = static_cast<float>(rss[i] * page_share);
+  }
+}
+
+void ProcessTable::ComputeKeys(SortKey sort) {
+  size_t rows = Size();
+  if (tree_) {
+    for (size_t i = 0; i < rows; ++i) {
+      const Totals& totals = subtree[i];
+      key[i] = sort == SortKey::kCpu      ? totals.cpu
+               : sort == SortKey::kMemory ? totals.rss
+                                          : totals.read_rate + totals.write_rate;
+    }
+    return;
+  }
+  switch (sort) {
+    case SortKey::kCpu:
+      for (size_t i = 0; i < rows; ++i) key[i] = cpu[i];
+      break;
+    case SortKey::kMemory:
+      for (size_t i = 0; i < rows; ++i) key[i] = rss[i];
+      break;
+    case SortKey::kIo:
+      for (size_t i = 0; i < rows; ++i) key[i] = read_rate[i] + write_rate[i];
+      break;
+  }
+}
+
+void ProcessTable::EnableTree(bool enabled) {
+  if (enabled == tree_) return;
+  tree_ = enabled;
+  if (!enabled) return;
+  // Totals go stale while the tree is off, so it is built over
+  size_t rows = Size();
+  for (size_t row = 0; row < rows; ++row) {
+    parent[row] = first_child[row] = 0;
+    next_sibling[row] = previous_sibling[row] = 0;
+    own[row] = subtree[row] = Totals{};
+  }
+  for (size_t row = 0; row < rows; ++row) Account(row);
+  for (size_t row = 0; row < rows; ++row) Link(row);
+}
+
+void ProcessTable::Link(size_t row) {
+  size_t candidate = ppid[row] > 0 ? Find(ppid[row]) : npos;
+  // A parent starts no later than its child; a pid that doesn't was reused
+  if (candidate != npos &&
+      (candidate == row || starttime[candidate] == 0 ||
+       starttime[candidate] > starttime[row])) {
+    candidate = npos;
+  }
+  int linked = candidate == npos ? 0 : pid[candidate];
+  if (linked == parent[row]) return;
+  // Start times can tie, so make sure the move doesn't close a loop
+  for (int ancestor = linked; ancestor != 0;) {
+    if (ancestor == pid[row]) return;
+    ancestor = parent[Find(ancestor)];
+  }
+  AddToAncestors(row, subtree[row], -1);
+  Unlink(row);
+  if (linked == 0) return;
+  parent[row] = linked;
+  next_sibling[row] = first_child[candidate];
+  if (next_sibling[row] != 0) {
+    previous_sibling[Find(next_sibling[row])] = pid[row];
+  }
+  first_child[candidate] = pid[row];
+  AddToAncestors(row, subtree[row], 1);
+}
+
+void ProcessTable::Account(size_t row) {
+  Totals now;
+  if (valid[row] && shown[row]) {
+    now.cpu = cpu[row];
+    now.rss = rss[row];
+    now.read_rate = std::max(read_rate[row], 0.0f);
+    now.write_rate = std::max(write_rate[row], 0.0f);
+    now.processes = 1;
+  }
+  const Totals& before = own[row];
+  // Most rows read on a tick are idle ones whose figures stay put
+  if (now.cpu == before.cpu && now.rss == before.rss &&
+      now.read_rate == before.read_rate &&
+      now.write_rate == before.write_rate &&
+      now.processes == before.processes) {
+    return;
+  }
+  Totals change = now;
+  change.Add(before, -1);
+  own[row] = now;
+  subtree[row].Add(change);
+  AddToAncestors(row, change, 1);
+}
+
+void ProcessTable::AddToAncestors(size_t row, const Totals& totals,
+                                  double scale) {
+  for (int ancestor = parent[row]; ancestor != 0; ancestor = parent[row]) {
+    row = Find(ancestor);
+    subtree[row].Add(totals, scale);
+  }
+}
+
+// Take a row out of its parent's list of children; totals are left as they
+// are
+void ProcessTable::Unlink(size_t row) {
+  if (parent[row] == 0) return;
+  int previous = previous_sibling[row];
+  int next = next_sibling[row];
+  if (previous != 0) {
+    next_sibling[Find(previous)] = next;
+  } else {
+    first_child[Find(parent[row])] = next;
+  }
+  if (next != 0) previous_sibling[Find(next)] = previous;
+  parent[row] = previous_sibling[row] = next_sibling[row] = 0;
+}
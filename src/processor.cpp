@@ -1,8 +1,48 @@
 #include "processor.h"
 #include "linux_parser.h"
 
-// Return the aggregate CPU utilization
+using std::vector;
+
+void Processor::Update() {
+    vector<LinuxParser::CPUStates> current = LinuxParser::CpuStates();
+    // Cores may come online between reads; new ones start from boot.
+    previous_.resize(current.size(), LinuxParser::CPUStates{});
+    utilization_.assign(current.size(), 0.0);
+
+    for (size_t i = 0; i < current.size(); ++i) {
+        long total = current[i].Total() - previous_[i].Total();
+        long active = current[i].Active() - previous_[i].Active();
+        if (total > 0) utilization_[i] = (float)active / total;
+    }
+
+    if (!current.empty()) {
+        const LinuxParser::CPUStates& now = current[0];
+        const LinuxParser::CPUStates& then = previous_[0];
+        float total = now.Total() - then.Total();
+        if (total > 0) {
+            iowait_ = (now.iowait - then.iowait) / total;
+            steal_ = (now.steal - then.steal) / total;
+            irq_ = (now.irq + now.softirq - then.irq - then.softirq) / total;
+        }
+    }
+    previous_ = current;
+}
+
+// Return the aggregate CPU utilization over the last interval
 float Processor::Utilization() {
-    //Get the firsrt value and convert from string to float using 'stof'
-    return LinuxParser::CpuUtilization();
-}
\ No newline at end of file
+    return utilization_.empty() ? 0.0 : utilization_[0];
+}
+
+int Processor::Cores() const {
+    return utilization_.empty() ? 0 : utilization_.size() - 1;
+}
+
+float Processor::CoreUtilization(int core) const {
+    return utilization_[core + 1];
+}
+
+float Processor::Iowait() const { return iowait_; }
+
+float Processor::Steal() const { return steal_; }
+
+float Processor::Irq() const { return irq_; }
@@ -0,0 +1,201 @@
+#include "recording.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+using std::size_t;
+
+static_assert(std::is_trivially_copyable_v<Recording::SnapshotRecord>,
+              "records are read in place from the mapping");
+static_assert(sizeof(Recording::Header) == 64, "header layout changed");
+
+namespace {
+// Copy into a fixed field, always NUL-terminated
+template <size_t N>
+void CopyText(char (&field)[N], const std::string& text) {
+  size_t length = std::min(text.size(), N - 1);
+  std::memcpy(field, text.data(), length);
+  std::memset(field + length, 0, N - length);
+}
+
+template <size_t N>
+std::string FieldText(const char (&field)[N]) {
+  return std::string(field, strnlen(field, N));
+}
+
+// `written` is read by replays of a file that is still being recorded
+std::uint64_t LoadWritten(const Recording::Header* header) {
+  return __atomic_load_n(&header->written, __ATOMIC_ACQUIRE);
+}
+}  // namespace
+
+Recording::Writer::~Writer() {
+  if (header_ != nullptr) munmap(header_, length_);
+}
+
+bool Recording::Writer::Open(const std::string& path, size_t bytes) {
+  size_t capacity = bytes > sizeof(Header)
+                        ? (bytes - sizeof(Header)) / sizeof(SnapshotRecord)
+                        : 0;
+  if (capacity == 0) {
+    errno = EINVAL;
+    return false;
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+
+  // Keep appending to a recording of the same layout and size; anything
+  // else is started over
+  Header existing{};
+  bool resume = pread(fd, &existing, sizeof(existing), 0) ==
+                    static_cast<ssize_t>(sizeof(existing)) &&
+                existing.magic == kMagic && existing.version == kVersion &&
+                existing.record_size == sizeof(SnapshotRecord) &&
+                existing.capacity == capacity;
+  size_t length = sizeof(Header) + capacity * sizeof(SnapshotRecord);
+  if ((!resume && ftruncate(fd, 0) != 0) || ftruncate(fd, length) != 0) {
+    close(fd);
+    return false;
+  }
+  void* mapping =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+
+  header_ = static_cast<Header*>(mapping);
+  records_ = reinterpret_cast<SnapshotRecord*>(header_ + 1);
+  length_ = length;
+  if (!resume) {
+    header_->magic = kMagic;
+    header_->version = kVersion;
+    header_->record_size = sizeof(SnapshotRecord);
+    header_->capacity = capacity;
+    header_->written = 0;
+  }
+  return true;
+}
+
+void Recording::Writer::Append(const Snapshot& snapshot,
+                               std::int64_t timestamp_ms) {
+  std::uint64_t written = header_->written;
+  SnapshotRecord& record = records_[written % header_->capacity];
+  record.timestamp_ms = timestamp_ms;
+  record.uptime = snapshot.uptime;
+  record.cpu = snapshot.cpu;
+  record.iowait = snapshot.iowait;
+  record.steal = snapshot.steal;
+  record.irq = snapshot.irq;
+  record.memory = snapshot.memory;
+  record.total_processes = snapshot.total_processes;
+  record.running_processes = snapshot.running_processes;
+  CopyText(record.os, snapshot.os);
+  CopyText(record.kernel, snapshot.kernel);
+
+  record.core_count = std::min<size_t>(snapshot.cores.size(), kMaxCores);
+  std::copy_n(snapshot.cores.begin(), record.core_count, record.cores);
+  std::fill(record.cores + record.core_count, record.cores + kMaxCores, 0.0f);
+
+  record.process_count =
+      std::min<size_t>(snapshot.processes.size(), kMaxProcesses);
+  for (int i = 0; i < kMaxProcesses; ++i) {
+    ProcessRecord& process = record.processes[i];
+    if (i >= record.process_count) {
+      std::memset(&process, 0, sizeof(process));
+      continue;
+    }
+    const ProcessRow& row = snapshot.processes[i];
+    process.pid = row.pid;
+    process.cpu = row.cpu;
+    process.uptime = row.uptime;
+    process.ram_mb = std::atoll(row.ram.c_str());
+    CopyText(process.user, row.user);
+    CopyText(process.command, row.command);
+  }
+  // Publish only once the record is whole
+  __atomic_store_n(&header_->written, written + 1, __ATOMIC_RELEASE);
+}
+
+Recording::Reader::~Reader() {
+  if (header_ != nullptr) munmap(const_cast<Header*>(header_), length_);
+}
+
+bool Recording::Reader::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat info {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  size_t length = info.st_size;
+  void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+
+  const Header* header = static_cast<const Header*>(mapping);
+  if (header->magic != kMagic || header->version != kVersion ||
+      header->record_size != sizeof(SnapshotRecord) ||
+      length < sizeof(Header) + header->capacity * sizeof(SnapshotRecord)) {
+    munmap(mapping, length);
+    errno = EINVAL;
+    return false;
+  }
+  header_ = header;
+  records_ = reinterpret_cast<const SnapshotRecord*>(header_ + 1);
+  length_ = length;
+  return true;
+}
+
+size_t Recording::Reader::Count() const {
+  return std::min<std::uint64_t>(LoadWritten(header_), header_->capacity);
+}
+
+// As a seqlock reader: the writer only overwrites record n once record
+// n + capacity - 1 is published, so a copy made before `written` is seen
+// still short of that was never touched
+bool Recording::Reader::Read(size_t index, SnapshotRecord& record) const {
+  std::uint64_t capacity = header_->capacity;
+  std::uint64_t written = LoadWritten(header_);
+  std::uint64_t oldest = written > capacity ? written - capacity : 0;
+  std::uint64_t sequence = oldest + index;
+  if (sequence >= written) return false;
+  std::memcpy(&record, &records_[sequence % capacity], sizeof(record));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (LoadWritten(header_) >= sequence + capacity) return false;
+  // Counts come from the file; past the arrays they'd be read out of bounds
+  return record.core_count <= kMaxCores &&
+         record.process_count <= kMaxProcesses;
+}
+
+void Recording::ToSnapshot(const SnapshotRecord& record, Snapshot& snapshot) {
+  snapshot.os = FieldText(record.os);
+  snapshot.kernel = FieldText(record.kernel);
+  snapshot.cpu = record.cpu;
+  snapshot.cores.assign(record.cores, record.cores + record.core_count);
+  snapshot.iowait = record.iowait;
+  snapshot.steal = record.steal;
+  snapshot.irq = record.irq;
+  snapshot.memory = record.memory;
+  snapshot.total_processes = record.total_processes;
+  snapshot.running_processes = record.running_processes;
+  snapshot.uptime = record.uptime;
+  snapshot.processes.resize(record.process_count);
+  for (int i = 0; i < record.process_count; ++i) {
+    const ProcessRecord& process = record.processes[i];
+    ProcessRow& row = snapshot.processes[i];
+    row.pid = process.pid;
+    row.user = FieldText(process.user);
+    row.cpu = process.cpu;
+    row.ram = std::to_string(process.ram_mb);
+    row.uptime = process.uptime;
+    row.command = FieldText(process.command);
+  }
+}
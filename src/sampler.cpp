@@ -0,0 +1,87 @@
+#include "sampler.h"
+
+Sampler::Sampler(System& system, std::size_t rows,
+                 std::chrono::milliseconds period)
+    : system_(system),
+      rows_(rows),
+      period_(period),
+      back_(&buffers_[0]),
+      front_(&buffers_[1]),
+      ready_(reinterpret_cast<std::uintptr_t>(&buffers_[2])),
+      options_(system.GetOptions()) {}
+
+Sampler::~Sampler() { Stop(); }
+
+void Sampler::Start() {
+  stopping_ = false;
+  thread_ = std::thread(&Sampler::Run, this);
+}
+
+void Sampler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+const Snapshot* Sampler::Latest() {
+  if ((ready_.load(std::memory_order_relaxed) & kFresh) == 0) return nullptr;
+  std::uintptr_t previous = ready_.exchange(
+      reinterpret_cast<std::uintptr_t>(front_), std::memory_order_acq_rel);
+  front_ = reinterpret_cast<Snapshot*>(previous & ~kFresh);
+  return front_;
+}
+
+void Sampler::SetOptions(System::Options options) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = std::move(options);
+    resample_ = true;
+  }
+  wake_.notify_all();
+}
+
+System::Options Sampler::Options() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return options_;
+}
+
+// Ticks are scheduled against absolute deadlines, so time spent sampling
+// doesn't stretch the period. A sample requested in between doesn't move
+// the next deadline.
+void Sampler::Run() {
+  auto deadline = std::chrono::steady_clock::now();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (resample_) system_.SetOptions(options_);
+      resample_ = false;
+    }
+    system_.Sample(*back_, rows_);
+    {
+      // Unless newer ones are waiting, the options are as System has them,
+      // less the pids that exited
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!resample_) {
+        options_.expanded = system_.GetOptions().expanded;
+        options_.collapsed = system_.GetOptions().collapsed;
+      }
+    }
+    std::uintptr_t previous =
+        ready_.exchange(reinterpret_cast<std::uintptr_t>(back_) | kFresh,
+                        std::memory_order_acq_rel);
+    back_ = reinterpret_cast<Snapshot*>(previous & ~kFresh);
+
+    auto now = std::chrono::steady_clock::now();
+    if (deadline <= now) {
+      deadline += period_;
+      // After a stall, skip the missed ticks instead of sampling back to back
+      if (deadline < now) deadline = now;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait_until(lock, deadline, [this] { return stopping_ || resample_; });
+    if (stopping_) return;
+  }
+}
@@ -1,10 +1,16 @@
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <limits>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "fd_cache.h"
+#include "instrument.h"
 #include "process.h"
+#include "process_history.h"
 #include "processor.h"
 #include "system.h"
 #include "linux_parser.h"
@@ -17,25 +23,486 @@ using std::vector;
 // Return the system's CPU
 Processor& System::Cpu() { return cpu_; }
 
-// Return a container composed of the system's processes
-vector<Process>& System::Processes() {
+void System::SetThreads(int threads) {
+    if (threads != pool_->Threads()) pool_ = std::make_unique<WorkerPool>(threads);
+}
+
+int System::Threads() const { return pool_->Threads(); }
+
+bool System::UseProcEvents() { return pids_.Subscribe(); }
+
+void System::SetOptions(Options options) {
+    std::sort(options.expanded.begin(), options.expanded.end());
+    std::sort(options.collapsed.begin(), options.collapsed.end());
+    table_.EnableTree(options.tree);
+    bool refilter = options.filter != filter_.Text();
+    if (refilter) {
+        if (!filter_.Parse(options.filter, nullptr)) filter_.Parse("", nullptr);
+        // Every process is judged afresh, on a read made at once
+        for (size_t row = 0; row < table_.Size(); ++row) {
+            Readmit(row);
+            table_.read[row] = 0;
+        }
+    }
+    options_ = std::move(options);
+    PruneOptions();
+}
+
+// Drop expanded and collapsed pids that have exited, so that a reused pid
+// doesn't come up expanded or folded
+void System::PruneOptions() {
+    for (vector<int>* pids : {&options_.expanded, &options_.collapsed}) {
+        pids->erase(std::remove_if(pids->begin(), pids->end(),
+                                   [this](int pid) { return table_.Find(pid) == ProcessTable::npos; }),
+                    pids->end());
+    }
+}
 
-    //Clear existing values
-    processes_.clear();
+const System::Options& System::GetOptions() const { return options_; }
 
-    vector<int> pidsList = LinuxParser::Pids();
+// Return the rows of the system's processes, ranked
+const vector<size_t>& System::Processes(size_t top_n) {
+    MONITOR_SCOPE(kRefresh);
+    FdCache& fds = FdCache::Instance();
+    fds.NextTick();
+    ++tick_;
 
-    for(int pid : pidsList) {
-        Process process;
-        process.setPid(pid);
-        processes_.emplace_back(process);
+    // Per-process caches follow the pid list's changes instead of being
+    // rebuilt; a pid reused in between is caught by its start time.
+    pids_.Scan();
+    for (int pid : pids_.Removed()) {
+        fds.Forget(pid);
+        info_.erase(pid);
+        table_.Remove(pid);
+    }
+    for (int pid : pids_.Added()) table_.Add(pid);
+    const vector<int>& pids = pids_.Pids();
+    bool removed = !pids_.Removed().empty();
+    if (table_.Size() != pids.size()) {
+        // Out of step, e.g. after a failed scan; start the table over
+        table_.Clear();
+        for (int pid : pids) table_.Add(pid);
+        removed = true;
+    }
+    if (removed) PruneOptions();
+    // An exec replaces the command line, and possibly the user, and says
+    // nothing about how busy the new program will be
+    for (int pid : pids_.Changed()) {
+        info_.erase(pid);
+        size_t row = table_.Find(pid);
+        if (row == ProcessTable::npos) continue;
+        table_.read[row] = 0;
+        Readmit(row);
     }
+    // Owners, comms and cgroups change without an exec; tests on them are
+    // only remembered while the proc connector reports such changes
+    filter_.RememberIdentity(pids_.Subscribed());
 
-    std::sort(processes_.begin(), processes_.end(), [ ](const Process& p1, const Process& p2) {
-        return p1.CpuUtilization() > p2.CpuUtilization();
+    // One /proc/uptime read per refresh, shared by every process
+    long uptime = LinuxParser::UpTime();
+
+    double now = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // Each process is written by exactly one worker, so collection needs no
+    // locking. Sorting by I/O, or summing it over subtrees, are the cases
+    // where the io file of every process that is due must be read.
+    // A filter is pushed down into collection: the owner and then the stat
+    // can rule a process out before anything more of it is read. In a tree
+    // an excluded process may still lead to ones that match, so its stat is
+    // read for its parent, but nothing else. A new start time (a reused
+    // pid) or comm (an exec, when nothing reports them) on a row's stat means
+    // another process, which is judged afresh.
+    bool read_io = options_.sort == SortKey::kIo || options_.tree;
+    bool filtering = !filter_.Empty();
+    Schedule();
+    pool_->ParallelFor(due_.size(), [&](size_t begin, size_t end) {
+        string comm;
+        for (size_t i = begin; i < end; ++i) {
+            size_t row = due_[i];
+            Process& process = table_.process[row];
+            if (filtering && !Admit(row, false) && !options_.tree) continue;
+            const LinuxParser::ProcStat& stat = process.Stat();
+            bool known = filtering && stat.valid;
+            unsigned long long starttime = stat.starttime;
+            if (known) comm = stat.comm;
+            process.Refresh(uptime);
+            if (known && stat.valid && (stat.starttime != starttime || stat.comm != comm)) {
+                Readmit(row);
+            }
+            if (table_.excluded[row] || (filtering && !Admit(row, true))) continue;
+            if (read_io) process.RefreshIo();
+        }
     });
+    for (size_t row : due_) {
+        bool excluded = table_.excluded[row];
+        if (excluded && !options_.tree) continue;
+        table_.Record(row, now);
+        if (read_io && !excluded) table_.RecordIo(row, now, tick_, table_.interval[row]);
+    }
+    // Memory shares are of the total taken with the system's utilization;
+    // a refresh on its own reads it only the first time
+    if (memory_total_kb_ == 0) memory_total_kb_ = LinuxParser::Memory().total_kb;
+    table_.ComputeUtilization(LinuxParser::ClockTicks(),
+                              static_cast<float>(memory_total_kb_) / LinuxParser::PageSizeKb());
+    // The rest of the filter, with utilization known; cmdline and cgroup
+    // are only read for processes that pass every cheaper test
+    if (filtering) {
+        pool_->ParallelFor(due_.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!table_.excluded[due_[i]]) Judge(due_[i]);
+            }
+        });
+    }
+    // Only the rows read can have moved or changed, so the tree follows
+    // them instead of being built again
+    if (table_.TreeEnabled()) {
+        for (size_t row : due_) {
+            table_.Link(row);
+            table_.Account(row);
+        }
+    }
+
+    // Set when each process read is next due. Any CPU, or I/O when sorting
+    // by it, since the last read keeps a process on every tick; otherwise
+    // its interval doubles up to the staleness bound. Intervals are
+    // shortened by a pid-dependent amount so that processes that went idle
+    // together don't all come due on the same later tick.
+    unsigned long max_staleness = std::max(options_.max_staleness, 1);
+    for (size_t row : due_) {
+        table_.read[row] = tick_;
+        if (table_.excluded[row]) {
+            // Placed in the tree; read again if orphaned, and judged afresh
+            // at the staleness bound (see Schedule())
+            table_.due[row] = std::numeric_limits<unsigned long>::max();
+            continue;
+        }
+        bool active = table_.time_before[row] == 0 || table_.cpu[row] > 0 ||
+                      table_.read_rate[row] > 0 || table_.write_rate[row] > 0;
+        unsigned long interval = active ? 1 : std::min(table_.interval[row] * 2, max_staleness);
+        table_.interval[row] = interval;
+        table_.due[row] = tick_ + interval - table_.pid[row] % ((interval + 1) / 2);
+    }
+
+    // Processes that exited since the scan are left out until the next scan
+    // drops them. Keys are compared by row, so ranking touches nothing but
+    // the key column; only the rows that will be shown need to be ordered.
+    {
+        MONITOR_SCOPE(kSort);
+        table_.ComputeKeys(options_.sort);
+        if (options_.tree) {
+            RankTree(top_n);
+            return order_;
+        }
+        order_.clear();
+        for (size_t row = 0; row < table_.Size(); ++row) {
+            if (table_.valid[row] && table_.shown[row]) order_.push_back(row);
+        }
+        size_t n = std::min(top_n, order_.size());
+        const vector<float>& key = table_.key;
+        std::partial_sort(order_.begin(), order_.begin() + n, order_.end(),
+            [&key](size_t a, size_t b) { return key[a] > key[b]; });
+    }
+    return order_;
+}
+
+const ProcessTable& System::Table() const { return table_; }
+
+// Whether a row about to be read can still match the filter, from the
+// fields fixed for its life: its owner alone, then with its fresh stat. A
+// row that can't is excluded, and skips everything else this tick.
+bool System::Admit(size_t row, bool with_stat) {
+    Filter::Facts facts;
+    facts.pid = table_.pid[row];
+    if (filter_.UsesUid()) {
+        if (table_.uid[row] < 0 || !filter_.RemembersIdentity()) {
+            table_.uid[row] = LinuxParser::Owner(facts.pid);
+            // Processes that aren't dumpable, like the workers of daemons
+            // that drop privileges, leave /proc/[pid] to root; status has
+            // the uid they run as, which USER shows
+            if (table_.uid[row] == 0) {
+                LinuxParser::ProcStatus status = LinuxParser::Status(facts.pid);
+                if (status.valid) table_.uid[row] = status.uid;
+            }
+        }
+        facts.uid = table_.uid[row];
+    }
+    const LinuxParser::ProcStat& stat = table_.process[row].Stat();
+    if (with_stat && stat.valid) facts.comm = &stat.comm;
+    if (filter_.Evaluate(facts, table_.filter[row]) != Filter::Result::kFalse) return true;
+    table_.excluded[row] = 1;
+    table_.shown[row] = 0;
+    return false;
+}
+
+// Whether a row read this tick matches the whole filter. Not matching on
+// state, cpu or mem only hides a row until it does; not matching on fixed
+// fields, now that cmdline and cgroup may have been read, excludes it.
+void System::Judge(size_t row) {
+    Filter::Facts facts;
+    facts.pid = table_.pid[row];
+    facts.uid = table_.uid[row];
+    const LinuxParser::ProcStat& stat = table_.process[row].Stat();
+    if (stat.valid) facts.comm = &stat.comm;
+    facts.fetch = true;
+    Filter::Facts fixed = facts;
+    if (stat.valid) facts.state = stat.state;
+    facts.cpu = table_.cpu[row];
+    facts.memory = table_.memory[row];
+    Filter::Cache& cache = table_.filter[row];
+    Filter::Fetched fetched;
+    table_.shown[row] = filter_.Evaluate(facts, cache, fetched) == Filter::Result::kTrue;
+    if (table_.shown[row]) return;
+    fixed.fetch = false;  // Only what was fetched above
+    if (filter_.Evaluate(fixed, cache, fetched) == Filter::Result::kFalse) table_.excluded[row] = 1;
+}
+
+// Forget how a row was judged, so its next read judges it afresh
+void System::Readmit(size_t row) {
+    table_.uid[row] = -1;
+    table_.filter[row] = {};
+    table_.excluded[row] = 0;
+    table_.shown[row] = 1;
+}
+
+// Depth first from the roots, each level ranked by key. Only as many rows
+// as are asked for are ranked at each level, and collapsed subtrees are
+// not entered, so the cost follows what is shown.
+void System::RankTree(size_t top_n) {
+    const vector<float>& key = table_.key;
+    auto push = [&](int depth) {
+        size_t n = std::min(siblings_.size(), top_n - order_.size());
+        std::partial_sort(siblings_.begin(), siblings_.begin() + n, siblings_.end(),
+            [&key](size_t a, size_t b) { return key[a] > key[b]; });
+        // Best last, so it is the next popped
+        for (size_t i = n; i-- > 0;) stack_.emplace_back(siblings_[i], depth);
+    };
+    // Processes that don't match stay in the tree while they lead to ones
+    // that do; subtree totals only count those that match
+    auto listed = [this](size_t row) {
+        return table_.valid[row] && table_.subtree[row].processes > 0.5;
+    };
+    order_.clear();
+    depth_.clear();
+    stack_.clear();
+    siblings_.clear();
+    for (size_t row = 0; row < table_.Size(); ++row) {
+        if (table_.parent[row] == 0 && listed(row)) siblings_.push_back(row);
+    }
+    push(0);
+    const vector<int>& collapsed = options_.collapsed;
+    while (!stack_.empty() && order_.size() < top_n) {
+        auto [row, depth] = stack_.back();
+        stack_.pop_back();
+        order_.push_back(row);
+        depth_.push_back(depth);
+        if (std::binary_search(collapsed.begin(), collapsed.end(), table_.pid[row])) continue;
+        siblings_.clear();
+        for (int child = table_.first_child[row]; child != 0;) {
+            size_t child_row = table_.Find(child);
+            if (listed(child_row)) siblings_.push_back(child_row);
+            child = table_.next_sibling[child_row];
+        }
+        push(depth + 1);
+    }
+}
+
+// Fill due_ with the rows to read this tick. New processes, the rows last
+// shown, expanded processes and any process at the staleness bound are
+// always read, so the bound holds whatever the budget. The budget caps the
+// rest that are due, longest overdue first. Excluded rows aren't read,
+// except in a tree to find their parent when it isn't known, until the
+// staleness bound: an owner, comm or cgroup can change, and a pid be
+// reused, without anything telling, so they are then judged afresh.
+void System::Schedule() {
+    for (const vector<int>* pinned : {&visible_, &options_.expanded}) {
+        for (int pid : *pinned) {
+            size_t row = table_.Find(pid);
+            if (row != ProcessTable::npos) table_.due[row] = 0;
+        }
+    }
+    unsigned long max_staleness = std::max(options_.max_staleness, 1);
+    const vector<unsigned long>& read = table_.read;
+    const vector<unsigned long>& due = table_.due;
+    due_.clear();
+    optional_.clear();
+    for (size_t row = 0; row < table_.Size(); ++row) {
+        if (table_.excluded[row]) {
+            if (tick_ - read[row] >= max_staleness) {
+                Readmit(row);
+            } else if (!(options_.tree && (due[row] == 0 || !table_.valid[row]))) {
+                continue;
+            }
+        }
+        if (read[row] == 0 || due[row] == 0 || tick_ - read[row] >= max_staleness) {
+            due_.push_back(row);
+        } else if (due[row] <= tick_) {
+            optional_.push_back(row);
+        }
+    }
+    size_t budget = options_.refresh_budget;
+    if (budget > 0) {
+        size_t room = budget > due_.size() ? budget - due_.size() : 0;
+        if (optional_.size() > room) {
+            std::nth_element(optional_.begin(), optional_.begin() + room, optional_.end(),
+                [&due](size_t a, size_t b) { return due[a] < due[b]; });
+            optional_.resize(room);
+        }
+    }
+    due_.insert(due_.end(), optional_.begin(), optional_.end());
+}
+
+void System::Sample(Snapshot& snapshot, size_t rows) {
+    MONITOR_SCOPE(kSample);
+    snapshot.os = OperatingSystem();
+    snapshot.kernel = Kernel();
+
+    cpu_.Update();
+    snapshot.cpu = cpu_.Utilization();
+    snapshot.cores.resize(cpu_.Cores());
+    for (int core = 0; core < cpu_.Cores(); ++core) {
+        snapshot.cores[core] = cpu_.CoreUtilization(core);
+    }
+    snapshot.iowait = cpu_.Iowait();
+    snapshot.steal = cpu_.Steal();
+    snapshot.irq = cpu_.Irq();
+
+    snapshot.memory = MemoryUtilization();
+    snapshot.total_processes = TotalProcesses();
+    snapshot.running_processes = RunningProcesses();
+    snapshot.uptime = UpTime();
+    snapshot.sort = options_.sort;
+    snapshot.detailed_memory = options_.detailed_memory;
+    snapshot.tree = options_.tree;
+    disks_.Update();
+    snapshot.disks = disks_.Rows();
+    network_.Update(options_.interfaces);
+    snapshot.interfaces = network_.Rows();
 
-    return processes_; 
+    const vector<size_t>& ranked = Processes(rows);
+    double now = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // Only visible rows pay for status and cmdline reads
+    rows = std::min(rows, ranked.size());
+    snapshot.processes.resize(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        size_t index = ranked[i];
+        Process& process = table_.process[index];
+        const ProcessInfo& info = Info(process);
+        ProcessRow& row = snapshot.processes[i];
+        row.pid = process.Pid();
+        row.user = info.user;
+        row.cpu = table_.cpu[index];
+        row.memory = table_.memory[index];
+        row.ram = process.Ram();
+        row.rss_kb = process.RssKb();
+        // smaps_rollup is the expensive one, so only rows pay for it
+        LinuxParser::ProcMemory memory;
+        if (options_.detailed_memory) memory = LinuxParser::SmapsRollup(row.pid);
+        row.pss_kb = memory.valid ? memory.pss_kb : -1;
+        row.uss_kb = memory.valid ? memory.uss_kb : -1;
+        row.swap_kb = memory.valid ? memory.swap_kb : -1;
+        // Sorting by I/O or tree mode has read every io file already
+        if (options_.sort != SortKey::kIo && !options_.tree) {
+            process.RefreshIo();
+            table_.RecordIo(index, now, tick_, 1);
+        }
+        row.read_rate = table_.read_rate[index];
+        row.write_rate = table_.write_rate[index];
+        row.uptime = process.UpTime();
+        row.command = info.command;
+        if (options_.tree) {
+            const ProcessTable::Totals& totals = table_.subtree[index];
+            const vector<int>& collapsed = options_.collapsed;
+            row.depth = depth_[i];
+            row.descendants = static_cast<int>(totals.processes - table_.own[index].processes + 0.5);
+            row.matches = table_.shown[index];
+            row.collapsed = std::binary_search(collapsed.begin(), collapsed.end(), row.pid);
+            row.subtree_cpu = totals.cpu;
+            row.subtree_rss_kb = static_cast<long>(totals.rss * LinuxParser::PageSizeKb());
+            row.subtree_read_rate = totals.read_rate;
+            row.subtree_write_rate = totals.write_rate;
+        } else {
+            row.depth = row.descendants = 0;
+            row.collapsed = false;
+            row.matches = true;
+        }
+        const vector<int>& expanded = options_.expanded;
+        if (std::binary_search(expanded.begin(), expanded.end(), row.pid)) {
+            SampleThreads(row.pid, snapshot.uptime, row.threads);
+        } else {
+            row.threads.clear();
+        }
+    }
+
+    // Shown rows are refreshed every tick while they stay on screen
+    visible_.clear();
+    for (const ProcessRow& row : snapshot.processes) visible_.push_back(row.pid);
+
+    // Thread samples are only kept while a process is expanded and shown
+    for (auto it = tids_.begin(); it != tids_.end();) {
+        bool shown = std::any_of(
+            snapshot.processes.begin(), snapshot.processes.end(),
+            [&](const ProcessRow& row) { return row.pid == it->first && !row.threads.empty(); });
+        if (shown) {
+            ++it;
+            continue;
+        }
+        for (int tid : it->second) thread_history_.Forget(tid);
+        it = tids_.erase(it);
+    }
+}
+
+// Interval CPU of every thread of one process, busiest first. Threads are
+// listed afresh each time, so this only runs for expanded processes.
+void System::SampleThreads(int pid, long uptime, vector<ThreadRow>& threads) {
+    double now = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    float ticks = LinuxParser::ClockTicks();
+    vector<int> tids = LinuxParser::Tids(pid);
+
+    // Forget threads that have exited since the last listing
+    vector<int>& previous = tids_[pid];
+    for (int tid : previous) {
+        if (!std::binary_search(tids.begin(), tids.end(), tid)) {
+            thread_history_.Forget(tid);
+        }
+    }
+
+    threads.resize(tids.size());
+    size_t kept = 0;
+    for (int tid : tids) {
+        LinuxParser::ProcStat stat = LinuxParser::TaskStat(pid, tid);
+        if (!stat.valid) continue;
+        // cutime and cstime are shared by the whole process; leave them out
+        long active = stat.Own();
+        float utilization;
+        if (!thread_history_.Update(tid, stat.starttime, active, now, &utilization)) {
+            float age = uptime - stat.starttime / ticks;
+            utilization = age > 0 ? active / ticks / age : 0;
+        }
+        ThreadRow& thread = threads[kept++];
+        thread.tid = tid;
+        thread.name = stat.comm;
+        thread.state = stat.state;
+        thread.cpu = utilization;
+    }
+    threads.resize(kept);
+    std::sort(threads.begin(), threads.end(),
+        [](const ThreadRow& a, const ThreadRow& b) { return a.cpu > b.cpu; });
+    previous = std::move(tids);
+}
+
+// User and command, keyed by (pid, starttime) so a reused pid is refetched
+const System::ProcessInfo& System::Info(Process& process) {
+    unsigned long long starttime = process.Stat().starttime;
+    auto it = info_.find(process.Pid());
+    if (it == info_.end() || it->second.starttime != starttime) {
+        ProcessInfo info{starttime, process.User(), process.Command()};
+        it = info_.insert_or_assign(process.Pid(), std::move(info)).first;
+    }
+    return it->second;
 }
 
 // Return the system's kernel identifier (string)
@@ -45,7 +512,9 @@ std::string System::Kernel() {
 
 // Return the system's memory utilization
 float System::MemoryUtilization() { 
-    return LinuxParser::MemoryUtilization(); 
+    LinuxParser::MemInfo memory = LinuxParser::Memory();
+    memory_total_kb_ = memory.total_kb;
+    return memory.utilization;
 }
 
 // Return the operating system name
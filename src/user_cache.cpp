@@ -0,0 +1,56 @@
+#include "user_cache.h"
+
+#include <sys/stat.h>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "instrument.h"
+#include "proc_reader.h"
+
+using std::string;
+
+UserCache::UserCache(string path) : path_(std::move(path)) {}
+
+string UserCache::Name(int uid) {
+  Revalidate();
+  auto it = names_.find(uid);
+  return it != names_.end() ? it->second : std::to_string(uid);
+}
+
+// Reload when the file was replaced (new inode) or edited in place
+void UserCache::Revalidate() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - checked_ < std::chrono::seconds(1) && size_ >= 0) return;
+  checked_ = now;
+
+  struct stat info {};
+  MONITOR_COUNT(kSyscalls, 1);
+  if (stat(path_.c_str(), &info) != 0) return;
+  if (info.st_dev == device_ && info.st_ino == inode_ &&
+      info.st_size == size_ && info.st_mtim.tv_sec == mtime_.tv_sec &&
+      info.st_mtim.tv_nsec == mtime_.tv_nsec) {
+    return;
+  }
+  device_ = info.st_dev;
+  inode_ = info.st_ino;
+  size_ = info.st_size;
+  mtime_ = info.st_mtim;
+  Load();
+}
+
+// name:password:uid:gid:gecos:home:shell
+void UserCache::Load() {
+  names_.clear();
+  ProcReader::Scanner scanner(ProcReader::ReadPath(path_.c_str()));
+  while (!scanner.AtEnd()) {
+    std::string_view line = scanner.Line();
+    size_t name_end = line.find(':');
+    if (name_end == std::string_view::npos) continue;
+    size_t uid_start = line.find(':', name_end + 1);
+    if (uid_start == std::string_view::npos) continue;
+    int uid = ProcReader::Scanner(line.substr(uid_start + 1)).ULong();
+    // The first entry wins, as with getpwuid()
+    names_.emplace(uid, string(line.substr(0, name_end)));
+  }
+}
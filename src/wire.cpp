@@ -0,0 +1,613 @@
+#include "wire.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+using std::int64_t;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+
+namespace {
+// Row layouts. Processes are keyed by pid, devices and interfaces by name.
+enum HeaderValue {
+  kUptime,
+  kCpu,
+  kIowait,
+  kSteal,
+  kIrq,
+  kMemory,
+  kTotalProcesses,
+  kRunningProcesses,
+  kFlags,  // Sort key, then detailed memory and tree bits
+  kHeaderValues
+};
+enum HeaderText { kHost, kOs, kKernel, kHeaderTexts };
+enum ProcessValue {
+  kPid,
+  kProcessCpu,
+  kProcessMemory,
+  kRss,
+  kPss,
+  kUss,
+  kSwap,
+  kRead,
+  kWrite,
+  kStarted,  // Seconds after boot, as ProcessRow::uptime has it
+  kDepth,
+  kDescendants,
+  kProcessFlags,  // Collapsed, then matches
+  kSubtreeCpu,
+  kSubtreeRss,
+  kSubtreeRead,
+  kSubtreeWrite,
+  kProcessValues
+};
+enum ProcessText { kUser, kCommand, kProcessTexts };
+enum DiskValue { kDiskRead, kDiskWrite, kIops, kUtilization, kDiskValues };
+enum InterfaceValue {
+  kRx,
+  kTx,
+  kRxPackets,
+  kTxPackets,
+  kDrops,
+  kErrors,
+  kInterfaceValues
+};
+constexpr int kName{0};
+
+struct Layout {
+  int values;
+  int texts;
+  bool named;  // Keyed by texts[kName] rather than values[0]
+};
+constexpr Layout kHeaderLayout{kHeaderValues, kHeaderTexts, false};
+constexpr Layout kProcessLayout{kProcessValues, kProcessTexts, false};
+constexpr Layout kDiskLayout{kDiskValues, 1, true};
+constexpr Layout kInterfaceLayout{kInterfaceValues, 1, true};
+static_assert(kProcessValues <= Wire::kMaxValues &&
+                  kHeaderTexts <= Wire::kMaxTexts,
+              "rows too small for their layouts");
+
+// Beyond any table's length; each row takes at least two bytes, and a
+// corrupt count is caught before it is allocated for
+constexpr uint64_t kMaxRows{1 << 16};
+
+// Fractions travel in hundredths of a percent, packet rates in tenths
+constexpr double kFraction{1e4};
+constexpr double kTenths{10};
+
+const Wire::Row kEmptyRow{};
+const Wire::Image kEmptyImage{};
+
+int64_t Fixed(double value, double scale = 1) {
+  return std::llround(value * scale);
+}
+
+float Real(int64_t value, double scale = 1) {
+  return static_cast<float>(value / scale);
+}
+
+void Resize(Wire::Table& table, size_t count) {
+  if (table.rows.size() < count) table.rows.resize(count);
+  table.count = count;
+}
+
+void Quantize(const Snapshot& snapshot, const string& host,
+              Wire::Image& image) {
+  int64_t* header = image.header.values;
+  header[kUptime] = snapshot.uptime;
+  header[kCpu] = Fixed(snapshot.cpu, kFraction);
+  header[kIowait] = Fixed(snapshot.iowait, kFraction);
+  header[kSteal] = Fixed(snapshot.steal, kFraction);
+  header[kIrq] = Fixed(snapshot.irq, kFraction);
+  header[kMemory] = Fixed(snapshot.memory, kFraction);
+  header[kTotalProcesses] = snapshot.total_processes;
+  header[kRunningProcesses] = snapshot.running_processes;
+  header[kFlags] = static_cast<int>(snapshot.sort) |
+                   snapshot.detailed_memory << 2 | snapshot.tree << 3;
+  image.header.texts[kHost] = host;
+  image.header.texts[kOs] = snapshot.os;
+  image.header.texts[kKernel] = snapshot.kernel;
+
+  image.cores.resize(snapshot.cores.size());
+  for (size_t i = 0; i < snapshot.cores.size(); ++i) {
+    image.cores[i] = Fixed(snapshot.cores[i], kFraction);
+  }
+
+  Resize(image.processes, snapshot.processes.size());
+  for (size_t i = 0; i < snapshot.processes.size(); ++i) {
+    const ProcessRow& process = snapshot.processes[i];
+    Wire::Row& row = image.processes.rows[i];
+    int64_t* values = row.values;
+    values[kPid] = process.pid;
+    values[kProcessCpu] = Fixed(process.cpu, kFraction);
+    values[kProcessMemory] = Fixed(process.memory, kFraction);
+    values[kRss] = process.rss_kb;
+    values[kPss] = process.pss_kb;
+    values[kUss] = process.uss_kb;
+    values[kSwap] = process.swap_kb;
+    values[kRead] = Fixed(process.read_rate);
+    values[kWrite] = Fixed(process.write_rate);
+    values[kStarted] = process.uptime;
+    values[kDepth] = process.depth;
+    values[kDescendants] = process.descendants;
+    values[kProcessFlags] = process.collapsed | process.matches << 1;
+    values[kSubtreeCpu] = Fixed(process.subtree_cpu, kFraction);
+    values[kSubtreeRss] = process.subtree_rss_kb;
+    values[kSubtreeRead] = Fixed(process.subtree_read_rate);
+    values[kSubtreeWrite] = Fixed(process.subtree_write_rate);
+    row.texts[kUser] = process.user;
+    row.texts[kCommand] = process.command;
+  }
+
+  Resize(image.disks, snapshot.disks.size());
+  for (size_t i = 0; i < snapshot.disks.size(); ++i) {
+    const DiskRow& disk = snapshot.disks[i];
+    Wire::Row& row = image.disks.rows[i];
+    row.values[kDiskRead] = Fixed(disk.read_rate);
+    row.values[kDiskWrite] = Fixed(disk.write_rate);
+    row.values[kIops] = Fixed(disk.iops, kTenths);
+    row.values[kUtilization] = Fixed(disk.utilization, kFraction);
+    row.texts[kName] = disk.name;
+  }
+
+  Resize(image.interfaces, snapshot.interfaces.size());
+  for (size_t i = 0; i < snapshot.interfaces.size(); ++i) {
+    const InterfaceRow& interface = snapshot.interfaces[i];
+    Wire::Row& row = image.interfaces.rows[i];
+    row.values[kRx] = Fixed(interface.rx_rate);
+    row.values[kTx] = Fixed(interface.tx_rate);
+    row.values[kRxPackets] = Fixed(interface.rx_packets, kTenths);
+    row.values[kTxPackets] = Fixed(interface.tx_packets, kTenths);
+    row.values[kDrops] = Fixed(interface.drops, kTenths);
+    row.values[kErrors] = Fixed(interface.errors, kTenths);
+    row.texts[kName] = interface.name;
+  }
+}
+
+void PutVarint(string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+// Small differences of either sign in few bytes
+void PutSigned(string& out, int64_t value) {
+  PutVarint(out, (static_cast<uint64_t>(value) << 1) ^
+                     static_cast<uint64_t>(value >> 63));
+}
+
+void PutText(string& out, const string& text) {
+  PutVarint(out, text.size());
+  out += text;
+}
+
+// Reads a payload, failing for good at the first malformed field
+class Reader {
+ public:
+  explicit Reader(string_view data) : data_(data) {}
+
+  uint64_t Varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (position_ >= data_.size()) break;
+      unsigned char byte = data_[position_++];
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return value;
+    }
+    failed_ = true;
+    return 0;
+  }
+
+  int64_t Signed() {
+    uint64_t value = Varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  // base plus a difference, wrapping rather than overflowing on a corrupt
+  // one
+  int64_t Next(int64_t base) {
+    return static_cast<int64_t>(static_cast<uint64_t>(base) +
+                                static_cast<uint64_t>(Signed()));
+  }
+
+  void Text(string& text) {
+    uint64_t size = Varint();
+    if (size > Left()) {
+      failed_ = true;
+      return;
+    }
+    text.assign(data_.data() + position_, size);
+    position_ += size;
+  }
+
+  // An upper bound on a count about to be read, so a corrupt one can't
+  // make the decoder allocate without limit
+  size_t Left() const { return data_.size() - position_; }
+  bool Failed() const { return failed_; }
+  bool Done() const { return position_ == data_.size(); }
+  void Fail() { failed_ = true; }
+
+ private:
+  string_view data_;
+  size_t position_{0};
+  bool failed_{false};
+};
+
+bool SameKey(const Wire::Row& a, const Wire::Row& b, const Layout& layout) {
+  return layout.named ? a.texts[kName] == b.texts[kName]
+                      : a.values[0] == b.values[0];
+}
+
+void EncodeRow(const Wire::Row& row, const Wire::Row& base,
+               const Layout& layout, string& out) {
+  uint64_t changed = 0;
+  for (int i = 0; i < layout.values; ++i) {
+    if (row.values[i] != base.values[i]) changed |= uint64_t{1} << i;
+  }
+  for (int i = 0; i < layout.texts; ++i) {
+    if (row.texts[i] != base.texts[i]) {
+      changed |= uint64_t{1} << (layout.values + i);
+    }
+  }
+  PutVarint(out, changed);
+  for (int i = 0; i < layout.values; ++i) {
+    if (changed >> i & 1) PutSigned(out, row.values[i] - base.values[i]);
+  }
+  for (int i = 0; i < layout.texts; ++i) {
+    if (changed >> (layout.values + i) & 1) PutText(out, row.texts[i]);
+  }
+}
+
+void DecodeRow(Reader& in, const Wire::Row& base, const Layout& layout,
+               Wire::Row& row) {
+  uint64_t changed = in.Varint();
+  if (changed >> (layout.values + layout.texts) != 0) in.Fail();
+  for (int i = 0; i < layout.values; ++i) {
+    row.values[i] = changed >> i & 1 ? in.Next(base.values[i]) : base.values[i];
+  }
+  for (int i = 0; i < layout.texts; ++i) {
+    if (changed >> (layout.values + i) & 1) {
+      in.Text(row.texts[i]);
+    } else {
+      row.texts[i] = base.texts[i];
+    }
+  }
+}
+
+// Each row refers to the row with its key in the base, if there is one,
+// and is encoded as its difference from that row or else from an empty
+// one. Rows mostly keep their places, so that one is tried first.
+void EncodeTable(const Wire::Table& table, const Wire::Table& base,
+                 const Layout& layout, string& out) {
+  PutVarint(out, table.count);
+  for (size_t i = 0; i < table.count; ++i) {
+    const Wire::Row& row = table.rows[i];
+    size_t reference = 0;
+    if (i < base.count && SameKey(row, base.rows[i], layout)) {
+      reference = i + 1;
+    } else {
+      for (size_t j = 0; j < base.count; ++j) {
+        if (SameKey(row, base.rows[j], layout)) {
+          reference = j + 1;
+          break;
+        }
+      }
+    }
+    PutVarint(out, reference);
+    EncodeRow(row, reference ? base.rows[reference - 1] : kEmptyRow, layout,
+              out);
+  }
+}
+
+void DecodeTable(Reader& in, const Wire::Table& base, const Layout& layout,
+                 Wire::Table& table) {
+  uint64_t count = in.Varint();
+  if (count > kMaxRows || count > in.Left() / 2) return in.Fail();
+  Resize(table, count);
+  for (size_t i = 0; i < count && !in.Failed(); ++i) {
+    uint64_t reference = in.Varint();
+    if (reference > base.count) return in.Fail();
+    DecodeRow(in, reference ? base.rows[reference - 1] : kEmptyRow, layout,
+              table.rows[i]);
+  }
+}
+
+// Appended as a whole frame, its length filled in at the end
+void Encode(const Wire::Image& image, const Wire::Image& base,
+            Wire::FrameType type, string& out) {
+  size_t start = out.size();
+  out.append(4, '\0');
+  out += static_cast<char>(type);
+  EncodeRow(image.header, base.header, kHeaderLayout, out);
+  PutVarint(out, image.cores.size());
+  for (size_t i = 0; i < image.cores.size(); ++i) {
+    PutSigned(out, image.cores[i] - (i < base.cores.size() ? base.cores[i] : 0));
+  }
+  EncodeTable(image.processes, base.processes, kProcessLayout, out);
+  EncodeTable(image.disks, base.disks, kDiskLayout, out);
+  EncodeTable(image.interfaces, base.interfaces, kInterfaceLayout, out);
+  std::uint32_t length = out.size() - start - 4;
+  for (int i = 0; i < 4; ++i) out[start + i] = static_cast<char>(length >> 8 * i);
+}
+
+bool Decode(Reader& in, const Wire::Image& base, Wire::Image& image) {
+  DecodeRow(in, base.header, kHeaderLayout, image.header);
+  uint64_t cores = in.Varint();
+  if (cores > in.Left()) return false;
+  image.cores.resize(cores);
+  for (size_t i = 0; i < cores; ++i) {
+    image.cores[i] = in.Next(i < base.cores.size() ? base.cores[i] : 0);
+  }
+  DecodeTable(in, base.processes, kProcessLayout, image.processes);
+  DecodeTable(in, base.disks, kDiskLayout, image.disks);
+  DecodeTable(in, base.interfaces, kInterfaceLayout, image.interfaces);
+  return !in.Failed() && in.Done();
+}
+
+// A socket file nobody accepts on was left by an agent that died
+bool StaleSocket(const sockaddr_un& address) {
+  struct stat info {};
+  if (lstat(address.sun_path, &info) != 0 || !S_ISSOCK(info.st_mode)) {
+    return false;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  bool refused =
+      connect(fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) != 0 &&
+      errno == ECONNREFUSED;
+  close(fd);
+  return refused;
+}
+
+bool LocalAddress(const Wire::Endpoint& endpoint, sockaddr_un& address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (endpoint.path.size() >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  std::memcpy(address.sun_path, endpoint.path.c_str(), endpoint.path.size());
+  return true;
+}
+
+addrinfo* Resolve(const Wire::Endpoint& endpoint, bool passive) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  const char* host = endpoint.host.empty() ? "localhost" : endpoint.host.c_str();
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host, endpoint.port.c_str(), &hints, &addresses) != 0) {
+    errno = EADDRNOTAVAIL;
+    return nullptr;
+  }
+  return addresses;
+}
+
+// A non-blocking socket connecting to `address`, or -1 with errno set
+int StartConnect(int family, const sockaddr* address, socklen_t length) {
+  int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd >= 0 && connect(fd, address, length) != 0 && errno != EINPROGRESS) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    fd = -1;
+  }
+  return fd;
+}
+}  // namespace
+
+void Wire::Encoder::Delta(const Snapshot& snapshot, string& out) {
+  Quantize(snapshot, host_, next_);
+  Encode(next_, sent_, kDelta, out);
+  std::swap(sent_, next_);
+}
+
+void Wire::Encoder::Keyframe(string& out) const {
+  Encode(sent_, kEmptyImage, kKeyframe, out);
+}
+
+bool Wire::Decoder::Apply(string_view payload) {
+  if (payload.size() == 1 && payload[0] == kKeepalive) return true;
+  bool keyframe = !payload.empty() && payload[0] == kKeyframe;
+  bool delta = !payload.empty() && payload[0] == kDelta && ready_;
+  Reader in(payload.substr(std::min<size_t>(1, payload.size())));
+  ready_ = (keyframe || delta) &&
+           Decode(in, keyframe ? kEmptyImage : image_, previous_);
+  if (ready_) std::swap(image_, previous_);
+  return ready_;
+}
+
+const string& Wire::Decoder::Host() const {
+  return image_.header.texts[kHost];
+}
+
+void Wire::Decoder::Expand(Snapshot& snapshot) const {
+  const int64_t* header = image_.header.values;
+  snapshot.os = image_.header.texts[kOs];
+  snapshot.kernel = image_.header.texts[kKernel];
+  snapshot.uptime = header[kUptime];
+  snapshot.cpu = Real(header[kCpu], kFraction);
+  snapshot.iowait = Real(header[kIowait], kFraction);
+  snapshot.steal = Real(header[kSteal], kFraction);
+  snapshot.irq = Real(header[kIrq], kFraction);
+  snapshot.memory = Real(header[kMemory], kFraction);
+  snapshot.total_processes = header[kTotalProcesses];
+  snapshot.running_processes = header[kRunningProcesses];
+  int sort = header[kFlags] & 3;
+  snapshot.sort = sort <= static_cast<int>(SortKey::kIo)
+                      ? static_cast<SortKey>(sort)
+                      : SortKey::kCpu;
+  snapshot.detailed_memory = header[kFlags] >> 2 & 1;
+  snapshot.tree = header[kFlags] >> 3 & 1;
+
+  snapshot.cores.resize(image_.cores.size());
+  for (size_t i = 0; i < image_.cores.size(); ++i) {
+    snapshot.cores[i] = Real(image_.cores[i], kFraction);
+  }
+
+  snapshot.processes.resize(image_.processes.count);
+  for (size_t i = 0; i < image_.processes.count; ++i) {
+    const Row& row = image_.processes.rows[i];
+    const int64_t* values = row.values;
+    ProcessRow& process = snapshot.processes[i];
+    process.pid = values[kPid];
+    process.user = row.texts[kUser];
+    process.cpu = Real(values[kProcessCpu], kFraction);
+    process.memory = Real(values[kProcessMemory], kFraction);
+    process.rss_kb = values[kRss];
+    process.ram = std::to_string(process.rss_kb / 1024);
+    process.pss_kb = values[kPss];
+    process.uss_kb = values[kUss];
+    process.swap_kb = values[kSwap];
+    process.read_rate = Real(values[kRead]);
+    process.write_rate = Real(values[kWrite]);
+    process.uptime = values[kStarted];
+    process.command = row.texts[kCommand];
+    process.depth = values[kDepth];
+    process.descendants = values[kDescendants];
+    process.collapsed = values[kProcessFlags] & 1;
+    process.matches = values[kProcessFlags] >> 1 & 1;
+    process.subtree_cpu = Real(values[kSubtreeCpu], kFraction);
+    process.subtree_rss_kb = values[kSubtreeRss];
+    process.subtree_read_rate = Real(values[kSubtreeRead]);
+    process.subtree_write_rate = Real(values[kSubtreeWrite]);
+    process.host.clear();
+    process.threads.clear();
+  }
+
+  snapshot.disks.resize(image_.disks.count);
+  for (size_t i = 0; i < image_.disks.count; ++i) {
+    const Row& row = image_.disks.rows[i];
+    DiskRow& disk = snapshot.disks[i];
+    disk.name = row.texts[kName];
+    disk.read_rate = Real(row.values[kDiskRead]);
+    disk.write_rate = Real(row.values[kDiskWrite]);
+    disk.iops = Real(row.values[kIops], kTenths);
+    disk.utilization = Real(row.values[kUtilization], kFraction);
+  }
+
+  snapshot.interfaces.resize(image_.interfaces.count);
+  for (size_t i = 0; i < image_.interfaces.count; ++i) {
+    const Row& row = image_.interfaces.rows[i];
+    InterfaceRow& interface = snapshot.interfaces[i];
+    interface.name = row.texts[kName];
+    interface.rx_rate = Real(row.values[kRx]);
+    interface.tx_rate = Real(row.values[kTx]);
+    interface.rx_packets = Real(row.values[kRxPackets], kTenths);
+    interface.tx_packets = Real(row.values[kTxPackets], kTenths);
+    interface.drops = Real(row.values[kDrops], kTenths);
+    interface.errors = Real(row.values[kErrors], kTenths);
+  }
+}
+
+long Wire::FrameSize(string_view data) {
+  if (data.size() < 4) return 0;
+  std::uint32_t length = 0;
+  for (int i = 0; i < 4; ++i) {
+    length |= static_cast<std::uint32_t>(static_cast<unsigned char>(data[i]))
+              << 8 * i;
+  }
+  if (length == 0 || length > kMaxFrame) return -1;
+  return data.size() - 4 < length ? 0 : 4 + static_cast<long>(length);
+}
+
+void Wire::Keepalive(string& out) {
+  out.append({1, 0, 0, 0, static_cast<char>(kKeepalive)});
+}
+
+bool Wire::ParseEndpoint(const string& text, Endpoint& endpoint) {
+  endpoint = {};
+  if (text.compare(0, 5, "unix:") == 0 || text.find('/') != string::npos) {
+    endpoint.local = true;
+    endpoint.path = text.compare(0, 5, "unix:") == 0 ? text.substr(5) : text;
+    return !endpoint.path.empty();
+  }
+  size_t colon = text.rfind(':');
+  endpoint.port = colon == string::npos ? text : text.substr(colon + 1);
+  if (colon != string::npos) endpoint.host = text.substr(0, colon);
+  // [::1]:7000
+  if (endpoint.host.size() >= 2 && endpoint.host.front() == '[' &&
+      endpoint.host.back() == ']') {
+    endpoint.host = endpoint.host.substr(1, endpoint.host.size() - 2);
+  }
+  return !endpoint.port.empty();
+}
+
+int Wire::Listen(const Endpoint& endpoint) {
+  if (endpoint.local) {
+    sockaddr_un address;
+    if (!LocalAddress(endpoint, address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (StaleSocket(address)) unlink(address.sun_path);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+      int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    return fd;
+  }
+  addrinfo* addresses = Resolve(endpoint, true);
+  if (addresses == nullptr) return -1;
+  int fd = -1;
+  for (addrinfo* address = addresses; address != nullptr && fd < 0;
+       address = address->ai_next) {
+    fd = socket(address->ai_family,
+                address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                address->ai_protocol);
+    if (fd < 0) continue;
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, address->ai_addr, address->ai_addrlen) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+      int error = errno;
+      close(fd);
+      errno = error;
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  return fd;
+}
+
+int Wire::Connect(const Endpoint& endpoint, std::size_t& next) {
+  if (endpoint.local) {
+    next = 0;
+    sockaddr_un address;
+    if (!LocalAddress(endpoint, address)) return -1;
+    return StartConnect(AF_UNIX, reinterpret_cast<const sockaddr*>(&address),
+                        sizeof(address));
+  }
+  addrinfo* addresses = Resolve(endpoint, false);
+  if (addresses == nullptr) {
+    next = 0;
+    return -1;
+  }
+  int fd = -1;
+  std::size_t index = 0;
+  addrinfo* address = addresses;
+  for (; address != nullptr && fd < 0; address = address->ai_next, ++index) {
+    if (index < next) continue;
+    fd = StartConnect(address->ai_family, address->ai_addr,
+                      address->ai_addrlen);
+  }
+  // The one after the address tried, if there is one
+  next = fd >= 0 && address != nullptr ? index : 0;
+  freeaddrinfo(addresses);
+  return fd;
+}
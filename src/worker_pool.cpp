@@ -0,0 +1,82 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+using std::size_t;
+
+WorkerPool::WorkerPool(int threads)
+    : threads_(std::max(1, threads)), shares_(new Share[threads_]) {
+  // Thread 0 is whoever calls ParallelFor()
+  for (int i = 1; i < threads_; ++i) workers_.emplace_back(&WorkerPool::Loop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+int WorkerPool::Threads() const { return threads_; }
+
+void WorkerPool::ParallelFor(
+    size_t count, const std::function<void(size_t, size_t)>& body) {
+  if (count == 0) return;
+  if (threads_ == 1) {
+    body(0, count);
+    return;
+  }
+
+  size_t share = (count + threads_ - 1) / threads_;
+  // Small enough to balance, large enough that the cursors stay cold
+  chunk_ = std::clamp<size_t>(share / 8, 1, 64);
+  for (int i = 0; i < threads_; ++i) {
+    shares_[i].next.store(std::min(count, i * share), std::memory_order_relaxed);
+    shares_[i].end = std::min(count, (i + 1) * share);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = &body;
+    running_ = threads_ - 1;
+    ++generation_;
+  }
+  start_.notify_all();
+
+  Work(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return running_ == 0; });
+  body_ = nullptr;
+}
+
+// Drain our own share first, then walk the others stealing what's left
+void WorkerPool::Work(int self) {
+  for (int offset = 0; offset < threads_; ++offset) {
+    Share& share = shares_[(self + offset) % threads_];
+    while (true) {
+      size_t begin = share.next.fetch_add(chunk_, std::memory_order_relaxed);
+      if (begin >= share.end) break;
+      (*body_)(begin, std::min(begin + chunk_, share.end));
+    }
+  }
+}
+
+void WorkerPool::Loop(int self) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) return;
+      seen = generation_;
+    }
+    Work(self);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --running_;
+    }
+    done_.notify_one();
+  }
+}